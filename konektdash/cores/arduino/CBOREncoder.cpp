@@ -0,0 +1,210 @@
+/*
+  CBOREncoder.cpp - Typed CBOR (RFC 7049) encoder that writes straight to a
+  Print, such as HologramCloud, without building a String first.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "CBOREncoder.h"
+
+#include <string.h>
+
+#define CBOR_UNSIGNED   0
+#define CBOR_NEGATIVE   1
+#define CBOR_BYTES      2
+#define CBOR_TEXT       3
+#define CBOR_ARRAY      4
+#define CBOR_MAP        5
+#define CBOR_SIMPLE     7
+
+#define CBOR_FALSE      0xF4
+#define CBOR_TRUE       0xF5
+#define CBOR_NULL       0xF6
+#define CBOR_HALF       0xF9
+#define CBOR_FLOAT      0xFA
+#define CBOR_DOUBLE     0xFB
+#define CBOR_BREAK      0xFF
+#define CBOR_INDEFINITE 31
+
+CBOREncoder::CBOREncoder(Print &out)
+: out(&out), written(0), failed(false) {
+}
+
+bool CBOREncoder::beginArray(uint32_t items) {
+    return head(CBOR_ARRAY, items);
+}
+
+bool CBOREncoder::beginArray() {
+    uint8_t b = (CBOR_ARRAY << 5) | CBOR_INDEFINITE;
+    return put(&b, 1);
+}
+
+bool CBOREncoder::beginMap(uint32_t pairs) {
+    return head(CBOR_MAP, pairs);
+}
+
+bool CBOREncoder::beginMap() {
+    uint8_t b = (CBOR_MAP << 5) | CBOR_INDEFINITE;
+    return put(&b, 1);
+}
+
+bool CBOREncoder::end() {
+    uint8_t b = CBOR_BREAK;
+    return put(&b, 1);
+}
+
+bool CBOREncoder::add(long long v) {
+    if(v < 0)
+        return head(CBOR_NEGATIVE, (unsigned long long)(-1 - v));
+    return head(CBOR_UNSIGNED, v);
+}
+
+bool CBOREncoder::add(unsigned long long v) {
+    return head(CBOR_UNSIGNED, v);
+}
+
+bool CBOREncoder::add(bool v) {
+    uint8_t b = v ? CBOR_TRUE : CBOR_FALSE;
+    return put(&b, 1);
+}
+
+bool CBOREncoder::addNull() {
+    uint8_t b = CBOR_NULL;
+    return put(&b, 1);
+}
+
+//smallest of half or single precision that holds the value exactly
+bool CBOREncoder::add(float v) {
+    uint8_t b[5];
+    uint16_t half;
+    if(toHalf(v, half)) {
+        b[0] = CBOR_HALF;
+        b[1] = half >> 8;
+        b[2] = half;
+        return put(b, 3);
+    }
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    b[0] = CBOR_FLOAT;
+    b[1] = bits >> 24;
+    b[2] = bits >> 16;
+    b[3] = bits >> 8;
+    b[4] = bits;
+    return put(b, 5);
+}
+
+bool CBOREncoder::add(double v) {
+    float f = (float)v;
+    if((double)f == v || v != v)
+        return add(f);
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    uint8_t b[9];
+    b[0] = CBOR_DOUBLE;
+    for(int i=0; i<8; i++) {
+        b[8-i] = bits >> (i*8);
+    }
+    return put(b, 9);
+}
+
+bool CBOREncoder::add(const char* str) {
+    return add(str, strlen(str));
+}
+
+bool CBOREncoder::add(const char* str, size_t length) {
+    return head(CBOR_TEXT, length) && put((const uint8_t*)str, length);
+}
+
+bool CBOREncoder::addBytes(const uint8_t* data, size_t length) {
+    return head(CBOR_BYTES, length) && put(data, length);
+}
+
+//major type and argument in the fewest bytes
+bool CBOREncoder::head(uint8_t major, unsigned long long value) {
+    uint8_t b[9];
+    int n;
+    b[0] = major << 5;
+    if(value < 24) {
+        b[0] |= value;
+        n = 1;
+    } else if(value <= 0xFF) {
+        b[0] |= 24;
+        b[1] = value;
+        n = 2;
+    } else if(value <= 0xFFFF) {
+        b[0] |= 25;
+        b[1] = value >> 8;
+        b[2] = value;
+        n = 3;
+    } else if(value <= 0xFFFFFFFF) {
+        uint32_t v = value;
+        b[0] |= 26;
+        b[1] = v >> 24;
+        b[2] = v >> 16;
+        b[3] = v >> 8;
+        b[4] = v;
+        n = 5;
+    } else {
+        b[0] |= 27;
+        for(int i=0; i<8; i++) {
+            b[8-i] = value >> (i*8);
+        }
+        n = 9;
+    }
+    return put(b, n);
+}
+
+//once a write falls short the output is truncated, stop adding to it
+bool CBOREncoder::put(const uint8_t* data, size_t length) {
+    if(failed) return false;
+    size_t n = out->write(data, length);
+    written += n;
+    failed = n != length;
+    return !failed;
+}
+
+bool CBOREncoder::toHalf(float f, uint16_t &half) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if(exponent == 128) {
+        //infinity keeps its sign, any NaN becomes the canonical quiet NaN
+        half = mantissa ? 0x7E00 : (sign | 0x7C00);
+        return true;
+    }
+    if(exponent == -127 && mantissa == 0) {
+        half = sign;
+        return true;
+    }
+    if(exponent >= -14 && exponent <= 15) {
+        if(mantissa & 0x1FFF) return false;
+        half = sign | ((exponent + 15) << 10) | (mantissa >> 13);
+        return true;
+    }
+    if(exponent >= -24 && exponent < -14) {
+        uint32_t full = mantissa | 0x800000;
+        int shift = -1 - exponent;
+        if(full & ((1UL << shift) - 1)) return false;
+        half = sign | (full >> shift);
+        return true;
+    }
+    return false;
+}
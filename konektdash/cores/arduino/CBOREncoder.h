@@ -0,0 +1,66 @@
+/*
+  CBOREncoder.h - Typed CBOR (RFC 7049) encoder that writes straight to a
+  Print, such as HologramCloud, without building a String first.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "Print.h"
+
+class CBOREncoder {
+public:
+    CBOREncoder(Print &out);
+
+    //containers with a known count take one header byte for up to 23
+    //items, the open ended forms need a closing end()
+    bool beginArray(uint32_t items);
+    bool beginArray();
+    bool beginMap(uint32_t pairs);
+    bool beginMap();
+    bool end();
+
+    bool add(int v)                         {return add((long long)v);}
+    bool add(unsigned int v)                {return add((unsigned long long)v);}
+    bool add(long v)                        {return add((long long)v);}
+    bool add(unsigned long v)               {return add((unsigned long long)v);}
+    bool add(long long v);
+    bool add(unsigned long long v);
+    bool add(bool v);
+    bool add(float v);
+    bool add(double v);
+    bool add(const char* str);
+    bool add(const char* str, size_t length);
+    bool add(const String &str)             {return add(str.c_str(), str.length());}
+    bool addBytes(const uint8_t* data, size_t length);
+    bool addNull();
+
+    size_t size()                           {return written;}
+    bool ok()                               {return !failed;}
+    void reset()                            {written = 0; failed = false;}
+
+protected:
+    bool head(uint8_t major, unsigned long long value);
+    bool put(const uint8_t* data, size_t length);
+    static bool toHalf(float f, uint16_t &half);
+
+    Print *out;
+    size_t written;
+    bool failed;
+};
@@ -136,11 +136,32 @@ void ClockClass::adjust(int8_t ticks)
     RTC_HAL_SetTimeCompensationRegister(RTC, ticks);
 }
 
+void ClockClass::adjust(int8_t ticks, uint16_t interval)
+{
+    if(interval < 1) interval = 1;
+    if(interval > 256) interval = 256;
+    RTC_HAL_SetCompensationIntervalRegister(RTC, interval - 1);
+    RTC_HAL_SetTimeCompensationRegister(RTC, ticks);
+}
+
 int8_t ClockClass::adjusted()
 {
     return (int8_t)RTC_HAL_GetTimeCompensationRegister(RTC);
 }
 
+uint16_t ClockClass::adjustInterval()
+{
+    return RTC_HAL_GetCompensationIntervalRegister(RTC) + 1;
+}
+
+void ClockClass::step(int32_t seconds)
+{
+    bool pending = RTC_HAL_ReadAlarmInt(RTC);
+    RTC_HAL_SetDatetimeInsecs(RTC, counter() + seconds);
+    if(pending)
+        RTC_HAL_SetAlarmReg(RTC, RTC_HAL_GetAlarmReg(RTC) + seconds);
+}
+
 uint32_t ClockClass::counter()
 {
     return RTC_HAL_GetSecsReg(RTC);
@@ -59,8 +59,14 @@ public:
 
     uint32_t counter();
 
+    //ticks are 32.768kHz cycles taken from (positive) or added to each
+    //compensation interval of 1 to 256 seconds, positive runs the clock faster
     void adjust(int8_t ticks);
+    void adjust(int8_t ticks, uint16_t interval);
     int8_t adjusted();
+    uint16_t adjustInterval();
+    //moves the time, a pending alarm moves with it so it is neither skipped nor early
+    void step(int32_t seconds);
 
     void alarmInterrupt();
     void secondsInterrupt();
@@ -32,10 +32,21 @@ void Hologram::attachHandlerSMS(void (*sms_handler)(const String &sender, const
     pollEvents();
 }
 
+//one connection at a time is read into the whole buffer, later ones wait
 void Hologram::attachHandlerInbound(void (*inbound_handler)(int length), void *buffer, int length) {
     inbound_callback = inbound_handler;
+    inbound_socket_callback = NULL;
     inbound_buffer = (uint8_t*)buffer;
     inbound_length = length;
+    inbound_parts = 1;
+}
+
+void Hologram::attachHandlerInbound(void (*inbound_handler)(int socket, const uint8_t *data, int length), void *buffer, int length) {
+    inbound_callback = NULL;
+    inbound_socket_callback = inbound_handler;
+    inbound_buffer = (uint8_t*)buffer;
+    inbound_length = length / INBOUND_SOCKETS;
+    inbound_parts = INBOUND_SOCKETS;
 }
 
 void Hologram::attachHandlerNotify(void (*event_handler)(cloud_event e)) {
@@ -50,12 +61,25 @@ void Hologram::attachHandlerCharge(void (*charge_handler)(charge_status status))
     charge_callback = charge_handler;
 }
 
+void Hologram::attachHandlerSent(void (*sent_handler)(bool success)) {
+    sent_callback = sent_handler;
+}
+
 void Hologram::begin() {
+    begin(SerialSystem);
+}
+
+void Hologram::begin(Stream &system) {
     end();
     // Serial2.begin(115200);
-    // modem.begin(SerialSystem, *this, &Serial2);
-    modem.begin(SerialSystem, *this);
+    // modem.begin(system, *this, &Serial2);
+    modem.begin(system, *this);
     ready = true;
+    sms_check = true; //anything received before we were listening
+    //devices reset together by a network outage should not retry in step
+    link_jitter = SIM_UIDL ^ micros();
+    if(link_jitter == 0) link_jitter = 1;
+    startProbing();
     powerUp();
 }
 
@@ -63,14 +87,33 @@ void Hologram::end() {
     ready = false;
     protocol_version = 0;
     modem_state = MODEM_STATE_UNKNOWN;
+    link_pending = false;
+    clock_pending = false;
+    window_open = false;
+    invalidateStatus();
+    invalidateIdentity();
     message_attempted = false;
     num_topics = 0;
-    inbound_pending = 0;
+    num_sticky = 0;
+    topic_pool_length = 0;
+    sent_count = -1;
+    topic_keep = 0;
+    send_state = SEND_IDLE;
+    batching = false;
+    batch_records = 0;
+    batch_flushing = false;
+    for(int i=0; i<INBOUND_SOCKETS; i++) {
+        inbound[i].id = 0;
+        inbound[i].part = -1;
+    }
+    inbound_reading = -1;
+    inbound_next = 0;
     sms_pending = false;
+    sms_state = SMS_IDLE;
 }
 
 bool Hologram::enterPassthrough() {
-    powerUp();
+    if(!linkUp()) return false;
     if(modem.set("+HPASSTHROUGH", "1") == MODEM_OK) {
         end();
         return true;
@@ -79,94 +122,278 @@ bool Hologram::enterPassthrough() {
 }
 
 int Hologram::checkSMS() {
-    if(modem_state != MODEM_STATE_READY) return 0;
+    int count = 0;
+    querySMS(count);
+    return count;
+}
+
+bool Hologram::querySMS(int &count) {
+    count = 0;
+    if(modem_state != MODEM_STATE_READY) return false;
     if(modem.query("+HSMS") == MODEM_OK) {
-        int num_sms;
-        if(sscanf(modem.lastResponse(), "+HSMS: %d", &num_sms) == 1) {
-            return num_sms;
+        if(parseResponse("+HSMS")) {
+            count = response_fields.toInt(0);
+            return true;
         }
     }
-    return 0;
+    return false;
 }
 
+//one short +HSOCKREAD in flight at a time, the open connections take
+//turns. A connection is delivered once the peer closes it, its part of the
+//buffer fills or it goes idle
 void Hologram::checkIncoming() {
-    if(inbound_pending == 0 || modem_state != MODEM_STATE_READY) return;
-    int readnum = 0;
-    int total = 0;
-    while(readnum != -1 && total < inbound_length) {
-      readnum = HologramCloud.read(inbound_pending, &inbound_buffer[total], inbound_length-total);
-      if(readnum > 0)
-        total += readnum;
+    if(modem_state != MODEM_STATE_READY) return;
+    for(int i=0; i<INBOUND_SOCKETS; i++) {
+        inbound_socket &s = inbound[i];
+        if(s.id == 0 || s.part < 0 || i == inbound_reading) continue;
+        if(s.closed || s.length >= inbound_length || millis() - s.last >= INBOUND_IDLE_MS)
+            deliverInbound(s, s.closed);
+    }
+    if(inbound_reading >= 0 || modem.queuedCommands() > 0) return;
+    for(int k=0; k<INBOUND_SOCKETS; k++) {
+        int i = (inbound_next + k) % INBOUND_SOCKETS;
+        inbound_socket &s = inbound[i];
+        if(s.id == 0 || (s.part < 0 && !assignPart(s))) continue;
+        inbound_next = (i + 1) % INBOUND_SOCKETS;
+        //the hex reply has to fit a response line
+        int n = inbound_length - s.length;
+        if(n > INBOUND_READ_CHUNK) n = INBOUND_READ_CHUNK;
+        char value[32];
+        sprintf(value, "%d,%d,%d,1", s.id, n, INBOUND_READ_MS); //hex mode
+        inbound_reading = i;
+        if(modem.submitSet("+HSOCKREAD", value, readStep, this, INBOUND_READ_MS+1000) != MODEM_OK)
+            inbound_reading = -1;
+        return;
     }
-    if(readnum != -1)
-        close(inbound_pending);
-    inbound_pending = 0;
-    inbound_callback(total);
 }
 
-void Hologram::onURC(const char* urc) {
-    if(strncmp(urc, "+HHSMSRX: %d", 9) == 0) {
-        //SMS Available, but do polling instead
-    } else if(strncmp(urc, "+HHSMSCTX: ", 10) == 0) {
-        int msglen = 0;
-        int numparams = sscanf(urc, "+HHSMSCTX: \"%[^\"]\",\"%d/%d/%d,%d:%d:%d\",%d", sms_sender, &sms_dt.year, &sms_dt.month, &sms_dt.day, &sms_dt.hour, &sms_dt.minute, &sms_dt.second, &msglen);
-        if(numparams == 8) {
-            modem.rawRead(msglen, sms_message);
-            sms_pending = true;
-        }
-    } else if(strncmp(urc, "+HHCONNECTED: ", 14) == 0) {
-        int con = 0;
-        if(event_callback) {
-            if(sscanf(urc, "+HHCONNECTED: %d", &con) == 1) {
-                event_callback(con == 1 ? CLOUD_EVENT_CONNECTED : CLOUD_EVENT_DISCONNECTED);
-            }
-        }
-    } else if(strncmp(urc, "+HHREGISTERED: ", 15) == 0) {
-        int status = 99;
-        if(sscanf(urc, "+HHREGISTERED: %d", &status) == 1) {
-            if(event_callback) {
-                if(status == 0)
-                    event_callback(CLOUD_EVENT_UNREGISTERED);
-                else if(status == 1)
-                    event_callback(CLOUD_EVENT_REGISTERED);
-            }
-        }
-    } else if(strncmp(urc, "+HHOLO: ", 8) == 0) {
-        sscanf(urc, "+HHOLO: %d", &protocol_version);
-        modem_state = MODEM_STATE_READY;
-        if(event_callback) {
-            event_callback(CLOUD_EVENT_RESET);
-        }
-    } else if(strncmp(urc, "+HHSOCKACCEPT: ", 14) == 0) {
-        int id, port, listener;
-        char host[16];
-        if(sscanf(urc, "+HHSOCKACCEPT: %d,\"%[^\"]\",%d,%d", &id, host, &port, &listener) == 4) {
-            if(inbound_callback && inbound_buffer && inbound_length > 0 && inbound_pending == 0) {
-                inbound_pending = id;
-            } else {
-                close(id);
-            }
+//+HSOCKREAD: <id>,<hex>,<length>,"<data>". ERROR once the peer has closed
+//and everything is read, a timeout only means nothing came
+void Hologram::readStep(modem_result r, const char* response, void *context) {
+    Hologram *h = (Hologram*)context;
+    if(h->inbound_reading < 0) return;
+    inbound_socket &s = h->inbound[h->inbound_reading];
+    h->inbound_reading = -1;
+    if(s.id == 0 || s.part < 0) return;
+    if(r == MODEM_ERROR) {
+        s.closed = true;
+        return;
+    }
+    const char* hex = strchr(response, '"');
+    if(r != MODEM_OK || !hex) return;
+    uint8_t *data = &h->inbound_buffer[s.part*h->inbound_length];
+    int n = 0;
+    for(hex++; s.length < h->inbound_length && hex[0] && hex[0] != '"' && hex[1]; hex += 2) {
+        data[s.length++] = Modem::convertHex(hex);
+        n++;
+    }
+    if(n > 0) s.last = millis();
+}
+
+bool Hologram::acceptSocket(int id) {
+    if(!(inbound_callback || inbound_socket_callback) || !inbound_buffer || inbound_length <= 0)
+        return false;
+    for(int i=0; i<INBOUND_SOCKETS; i++) {
+        if(inbound[i].id == 0 && inbound[i].part < 0) {
+            inbound[i].id = id;
+            inbound[i].closed = false;
+            inbound[i].last = millis();
+            return true;
         }
-    } else if(strncmp(urc, "+HHLOC: ", 8) == 0) {
-        //+HHLOC: "2011/04/13,09:54:51",45.6334520,13.0618620,49,1
-        int altitude, uncertainty;
-        int numparams = sscanf(urc, "+HHLOC: \"%d/%d/%d,%d:%d:%d\",%[^,],%[^,],%d,%d", &loc_dt.year, &loc_dt.month, &loc_dt.day, &loc_dt.hour, &loc_dt.minute, &loc_dt.second, loc_lat, loc_lon, &altitude, &uncertainty);
-        if(numparams == 10) {
-            if(location_callback) {
-                location_callback(loc_dt, loc_lat, loc_lon, altitude, uncertainty);
-            }
+    }
+    return false;
+}
+
+bool Hologram::assignPart(inbound_socket &s) {
+    for(int p=0; p<inbound_parts; p++) {
+        int i = 0;
+        while(i < INBOUND_SOCKETS && inbound[i].part != p) i++;
+        if(i == INBOUND_SOCKETS) {
+            s.part = p;
+            s.length = 0;
+            s.last = millis();
+            return true;
         }
-    } else if(strncmp(urc, "+HHCHARGE: ", 11) == 0) {
-        int charge_state = 0;
-        if(sscanf(urc, "+HHCHARGE: %d", &charge_state) == 1) {
-            if(charge_callback) {
-                charge_callback((charge_status)(charge_state));
-            }
+    }
+    return false;
+}
+
+//the part stays reserved through the callback in case it polls again
+void Hologram::deliverInbound(inbound_socket &s, bool closed) {
+    int id = s.id;
+    if(!closed) {
+        char value[12];
+        sprintf(value, "%d", id);
+        if(modem.submitSet("+HSOCKCLOSE", value, NULL, NULL, 3*1000) != MODEM_OK)
+            close(id);
+    }
+    s.id = 0;
+    if(inbound_socket_callback)
+        inbound_socket_callback(id, &inbound_buffer[s.part*inbound_length], s.length);
+    else if(inbound_callback)
+        inbound_callback(s.length);
+    s.part = -1;
+}
+
+//sorted by prefix for URCTable
+const urc_entry Hologram::URCS[] = {
+    {"+HHCHARGE",       Hologram::urcCharge},
+    {"+HHCONNECTED",    Hologram::urcConnected},
+    {"+HHLOC",          Hologram::urcLocation},
+    {"+HHOLO",          Hologram::urcHolo},
+    {"+HHREGISTERED",   Hologram::urcRegistered},
+    {"+HHSMSCTX",       Hologram::urcSMSContent},
+    {"+HHSMSRX",        Hologram::urcSMSReceived},
+    {"+HHSOCKACCEPT",   Hologram::urcSocketAccept},
+};
+
+const size_t Hologram::NUM_URCS = URC_TABLE_SIZE(Hologram::URCS);
+
+bool Hologram::attachHandlerURC(const urc_entry *table, size_t count, void *context) {
+    if(num_urc_tables == MAX_URC_TABLES) return false;
+    URCTable t(table, count, context);
+    if(!t.isSorted()) return false;
+    urc_tables[num_urc_tables++] = t;
+    return true;
+}
+
+void Hologram::onURC(const char* urc) {
+    if(!urc_fields.parse(urc)) return;
+    URCTable(URCS, NUM_URCS, this).dispatch(urc_fields);
+    for(int i=0; i<num_urc_tables; i++) {
+        urc_tables[i].dispatch(urc_fields);
+    }
+}
+
+bool Hologram::toDateTime(const ATFields &fields, int i, rtc_datetime_t &dt, int *tz) {
+    at_date date;
+    if(!fields.toDate(i, date)) return false;
+    dt.year = date.year;
+    dt.month = date.month;
+    dt.day = date.day;
+    dt.hour = date.hour;
+    dt.minute = date.minute;
+    dt.second = date.second;
+    if(tz) *tz = date.tz;
+    return true;
+}
+
+bool Hologram::parseResponse(const char* prefix) {
+    return response_fields.parse(modem.lastResponse()) &&
+        response_fields.is(prefix) && response_fields.count() > 0;
+}
+
+void Hologram::setStatus(int status) {
+    status_cache = status;
+    status_time = millis();
+}
+
+//the SIM can be swapped and the firmware updated while the system processor is down
+void Hologram::invalidateIdentity() {
+    iccid[0] = 0;
+    imsi[0] = 0;
+    sys_version[0] = 0;
+    net_operator[0] = 0;
+}
+
+static void copyResponse(char *dest, const char* src, size_t size) {
+    strncpy(dest, src, size-1);
+    dest[size-1] = 0;
+}
+
+void Hologram::urcSMSReceived(const ATFields &fields, void *context) {
+    //+HHSMSRX: count, read them from pollEvents
+    ((Hologram*)context)->sms_check = true;
+}
+
+void Hologram::urcSMSContent(const ATFields &fields, void *context) {
+    //+HHSMSCTX: "sender","17/06/01,12:00:00",msglen
+    Hologram *h = (Hologram*)context;
+    if(fields.count() == 3 && toDateTime(fields, 1, h->sms_dt)) {
+        fields.copy(0, h->sms_sender, sizeof(h->sms_sender));
+        int msglen = fields.toInt(2);
+        if(msglen >= (int)sizeof(h->sms_message)) msglen = sizeof(h->sms_message)-1;
+        modem.rawRead(msglen, h->sms_message);
+        h->sms_pending = true;
+    }
+}
+
+void Hologram::urcConnected(const ATFields &fields, void *context) {
+    Hologram *h = (Hologram*)context;
+    //disconnected leaves registration unknown
+    if(fields.count() >= 1 && fields.toInt(0) == 1)
+        h->setStatus(CLOUD_CONNECTED);
+    else
+        h->invalidateStatus();
+    if(h->event_callback && fields.count() >= 1) {
+        h->event_callback(fields.toInt(0) == 1 ? CLOUD_EVENT_CONNECTED : CLOUD_EVENT_DISCONNECTED);
+    }
+}
+
+void Hologram::urcRegistered(const ATFields &fields, void *context) {
+    Hologram *h = (Hologram*)context;
+    int status = fields.toInt(0, 99);
+    if(status == 0)
+        h->setStatus(CLOUD_ERR_UNREGISTERED);
+    else
+        h->invalidateStatus();
+    h->net_operator[0] = 0; //may have moved networks
+    if(h->event_callback) {
+        if(status == 0)
+            h->event_callback(CLOUD_EVENT_UNREGISTERED);
+        else if(status == 1)
+            h->event_callback(CLOUD_EVENT_REGISTERED);
+    }
+}
+
+void Hologram::urcHolo(const ATFields &fields, void *context) {
+    Hologram *h = (Hologram*)context;
+    h->protocol_version = fields.toInt(0, h->protocol_version);
+    h->write_chunk_limit = 0;
+    h->sms_check = true;
+    h->sent_count = -1;
+    h->topic_keep = 0;
+    h->invalidateStatus();
+    h->invalidateIdentity();
+    h->linkReady();
+    if(h->event_callback) {
+        h->event_callback(CLOUD_EVENT_RESET);
+    }
+}
+
+void Hologram::urcSocketAccept(const ATFields &fields, void *context) {
+    //+HHSOCKACCEPT: id,"host",port,listener
+    Hologram *h = (Hologram*)context;
+    if(fields.count() == 4) {
+        int id = fields.toInt(0);
+        if(!h->acceptSocket(id))
+            h->close(id);
+    }
+}
+
+void Hologram::urcLocation(const ATFields &fields, void *context) {
+    //+HHLOC: "2011/04/13,09:54:51",45.6334520,13.0618620,49,1
+    Hologram *h = (Hologram*)context;
+    if(fields.count() == 5 && toDateTime(fields, 0, h->loc_dt)) {
+        fields.copy(1, h->loc_lat, sizeof(h->loc_lat));
+        fields.copy(2, h->loc_lon, sizeof(h->loc_lon));
+        if(h->location_callback) {
+            h->location_callback(h->loc_dt, h->loc_lat, h->loc_lon, fields.toInt(3), fields.toInt(4));
         }
     }
 }
 
+void Hologram::urcCharge(const ATFields &fields, void *context) {
+    Hologram *h = (Hologram*)context;
+    if(fields.count() >= 1 && h->charge_callback) {
+        h->charge_callback((charge_status)fields.toInt(0));
+    }
+}
+
 void Hologram::resetSystem() {
+    stats.resets++;
+    sent_count = -1;
     pinMode(26, OUTPUT);
     digitalWrite(26, LOW);
     Dash.snooze(10);
@@ -180,9 +407,8 @@ int Hologram::listen(int port) {
         modem.startSet("+HSOCKLISTEN");
         modem.appendSet(port);
         if(modem.completeSet(10*1000) == MODEM_OK) {
-            int socket;
-            if(sscanf(modem.lastResponse(), "+HSOCKLISTEN: %d", &socket) == 1) {
-                return socket;
+            if(parseResponse("+HSOCKLISTEN")) {
+                return response_fields.toInt(0);
             }
         }
     }
@@ -199,21 +425,9 @@ int Hologram::read(int socket, void *buffer, int max_len, int timeout) {
     modem.appendSet(",");
     modem.appendSet(timeout);
     modem.appendSet(",1"); //hex mode
-    if(modem.completeSet(timeout+1000) == MODEM_OK) {
-        int socket, hex, actual_read;
-        if(sscanf(modem.lastResponse(), "+HSOCKREAD: %d,%d,%d,", &socket, &hex, &actual_read) == 3) {
-            if(actual_read > 0) {
-                const char* q = strchr(modem.lastResponse(), '"');
-                if(hex == 1) {
-                    for(int i=0; i<actual_read; i++) {
-                        ((uint8_t*)buffer)[i] = Modem::convertHex(&q[1+i*2]);
-                    }
-                } else {
-                    memcpy(buffer, &q[1], actual_read);
-                }
-            }
-            return actual_read;
-        }
+    int actual_read = 0;
+    if(modem.completeSetPayload((uint8_t*)buffer, max_len, &actual_read, timeout+1000) == MODEM_OK) {
+        return actual_read;
     }
     return -1;
 }
@@ -227,14 +441,16 @@ void Hologram::close(int socket) {
 }
 
 bool Hologram::connect() {
-    powerUp();
-    return true;
+    return powerUp();
 }
 
 bool Hologram::disconnect() {
-    if(modem_state == MODEM_STATE_READY) {
+    if(modem_state == MODEM_STATE_CONNECTING) {
+        modem_state = MODEM_STATE_DISCONNECTED;
+    } else if(modem_state == MODEM_STATE_READY) {
         if(modem.command("+HDISCONNECT", 30*1000) == MODEM_OK) {
             modem_state = MODEM_STATE_DISCONNECTED;
+            invalidateStatus();
         }
     }
     return true;
@@ -251,9 +467,19 @@ bool Hologram::isRegistered() {
 
 int Hologram::getConnectionStatus() {
     int status = CLOUD_ERR_UNAVAILABLE;
+    if(ready && modem_state != MODEM_STATE_SHUTDOWN) {
+        modem.checkURC(); //transitions reported since the last call
+        if(!isModemReady())
+            checkConnection(); //so a loop on isConnected() sees the link come up
+    }
     if(modem_state > MODEM_STATE_SHUTDOWN) {
-        if(modem.command("+HCONSTATUS") == MODEM_OK) {
-            sscanf(modem.lastResponse(), "+HCONSTATUS: %d", &status);
+        if(status_cache >= 0 && millis() - status_time < CLOUD_STATUS_TTL_MS) {
+            stats.cache_hits++;
+            return status_cache;
+        }
+        if(modem.command("+HCONSTATUS") == MODEM_OK && parseResponse("+HCONSTATUS")) {
+            status = response_fields.toInt(0, status);
+            setStatus(status);
         }
         return status;
     }
@@ -271,25 +497,26 @@ int Hologram::sendDelay(bool ok, int milliseconds) {
 }
 
 int Hologram::getSignalStrength() {
-    if(modem_state == MODEM_STATE_DISCONNECTED) return 99;
-    powerUp();
+    if(!linkUp()) return 99;
     if(modem.command("+CSQ") != MODEM_OK)
         return 99;
-    int rssi = 99;
-    int qual = 0;
-    sscanf(modem.lastResponse(), "+CSQ: %d,%d", &rssi, &qual);
-    return rssi;
+    if(!parseResponse("+CSQ"))
+        return 99;
+    return response_fields.toInt(0, 99);
 }
 
 bool Hologram::getTime(rtc_datetime_t &dt, bool utc) {
-    if(modem_state == MODEM_STATE_DISCONNECTED) return false;
-    powerUp();
+    if(!linkUp()) return false;
     if(modem.query("+CCLK") != MODEM_OK) {
         return false;
     }
+    return timeResponse(modem.lastResponse(), dt, utc);
+}
 
+bool Hologram::timeResponse(const char* response, rtc_datetime_t &dt, bool utc) {
     int tz;
-    if(sscanf(modem.lastResponse(), "+CCLK: \"%d/%d/%d,%d:%d:%d%d", &dt.year, &dt.month, &dt.day, &dt.hour, &dt.minute, &dt.second, &tz) == 7) {
+    if(response_fields.parse(response) && response_fields.is("+CCLK") &&
+        response_fields.count() > 0 && toDateTime(response_fields, 0, dt, &tz)) {
         if(dt.year == 4) { //good until 2104 and ublox-specfiic
             return false;
         }
@@ -315,73 +542,171 @@ bool Hologram::getNetworkTime(rtc_datetime_t &dt) {
 }
 
 bool Hologram::getUTC(rtc_datetime_t &dt) {
+    if(clock_synced) {
+        Clock.getDateTime(dt);
+        return true;
+    }
     return getTime(dt, true);
 }
 
+void Hologram::beginClockSync(uint32_t interval) {
+    clock_sync = true;
+    clock_synced = false;
+    clock_interval = interval;
+    clock_next = Clock.counter();
+    clock_base = 0;
+    memset(&clock_stats, 0, sizeof(clock_stats));
+    //the compensation survives resets in the RTC, start from what is there
+    clock_stats.drift_ppb = (int64_t)Clock.adjusted() * 1000000000 / ((int64_t)Clock.adjustInterval() * 32768);
+}
+
+void Hologram::endClockSync() {
+    clock_sync = false;
+    clock_synced = false;
+}
+
+void Hologram::checkClockSync() {
+    if(!clock_sync || clock_pending || !isModemReady() || modem.queuedCommands() > 0 || sendBusy()) return;
+    if((int32_t)(Clock.counter() - clock_next) < 0) return;
+    clock_pending = true; //the query may complete inside submit
+    if(modem.submitQuery("+CCLK", clockStep, this) != MODEM_OK)
+        clock_pending = false;
+}
+
+void Hologram::clockStep(modem_result r, const char* response, void *context) {
+    Hologram *h = (Hologram*)context;
+    rtc_datetime_t dt;
+    uint32_t network = 0;
+    h->clock_pending = false;
+    if(!h->clock_sync) return;
+    if(r == MODEM_OK && h->timeResponse(response, dt, true)) {
+        RTC_HAL_ConvertDatetimeToSecs(&dt, &network);
+        h->syncClock(network);
+        h->clock_next = Clock.counter() + h->clock_interval;
+    } else {
+        h->clock_stats.failures++;
+        h->clock_next = Clock.counter() + CLOCK_SYNC_RETRY_S;
+    }
+}
+
+//+CCLK and the RTC both count whole seconds, so the drift is only estimated
+//once the error has grown well past that
+void Hologram::syncClock(uint32_t network) {
+    int32_t offset = (int32_t)(Clock.counter() - network);
+    clock_stats.syncs++;
+    clock_stats.last_offset = offset;
+
+    int32_t error = clock_error + offset;
+    int32_t span = (int32_t)(network - clock_base);
+    bool estimate = error >= CLOCK_DRIFT_ERROR_S || error <= -CLOCK_DRIFT_ERROR_S;
+    int64_t residual = span > 0 ? (int64_t)error * 1000000000 / span : 0;
+
+    //first sync, or the RTC was set or lost its time: nothing to learn from
+    if(clock_base == 0 || span <= 0 ||
+        (estimate && (residual > CLOCK_DRIFT_MAX_PPB || residual < -CLOCK_DRIFT_MAX_PPB))) {
+        if(offset != 0) {
+            Clock.step(-offset);
+            clock_stats.steps++;
+        }
+        clock_base = network;
+        clock_error = 0;
+        clock_synced = true;
+        return;
+    }
+
+    if(estimate)
+        setDrift(clock_stats.drift_ppb - residual);
+    if(offset >= 2 || offset <= -2) {
+        Clock.step(-offset);
+        clock_stats.steps++;
+        clock_error += offset;
+        offset = 0;
+    }
+    if(estimate) {
+        clock_base = network;
+        clock_error = -offset;
+    }
+}
+
+//the longest compensation interval that still fits the correction in a tick register
+void Hologram::setDrift(int32_t ppb) {
+    int64_t magnitude = ppb < 0 ? -(int64_t)ppb : ppb;
+    int64_t interval = magnitude ? 127LL * 1000000000 / (magnitude * 32768) : 256;
+    if(interval > 256) interval = 256;
+    if(interval < 1) interval = 1;
+    int64_t ticks = ((int64_t)ppb * interval * 32768 + (ppb < 0 ? -500000000 : 500000000)) / 1000000000;
+    if(ticks > 127) ticks = 127;
+    if(ticks < -127) ticks = -127;
+    Clock.adjust((int8_t)ticks, (uint16_t)interval);
+    clock_stats.drift_ppb = ticks * 1000000000 / (interval * 32768);
+}
+
 int Hologram::getChargeState() {
     int charge = 8;
     if(modem_state > MODEM_STATE_SHUTDOWN) {
-        if(modem.query("+HCHARGE") == MODEM_OK)
-            sscanf(modem.lastResponse(), "+HCHARGE: %d", &charge);
+        if(modem.query("+HCHARGE") == MODEM_OK && parseResponse("+HCHARGE"))
+            charge = response_fields.toInt(0, charge);
     }
     return charge;
 }
 
 String Hologram::systemVersion() {
-    char ver[9];
-    int value=0;
-    if(modem_state > MODEM_STATE_SHUTDOWN) {
-        if(modem.set("+HSYS", "2") == MODEM_OK) {
-            if(sscanf(modem.lastResponse(), "+HSYS: %d,\"%[^\"]\"", &value, ver) == 2) {
-                if(value == 2)
-                    return String(ver);
-            }
+    if(sys_version[0]) {
+        stats.cache_hits++;
+    } else if(modem_state > MODEM_STATE_SHUTDOWN) {
+        if(modem.set("+HSYS", "2") == MODEM_OK && parseResponse("+HSYS")) {
+            if(response_fields.toInt(0) == 2 && response_fields.count() == 2)
+                response_fields.copy(1, sys_version, sizeof(sys_version));
         }
     }
-    return String("0.0.0");
+    return String(sys_version[0] ? sys_version : "0.0.0");
 }
 
 String Hologram::getICCID() {
-    if(modem_state != MODEM_STATE_DISCONNECTED) {
-        powerUp();
+    if(iccid[0]) {
+        stats.cache_hits++;
+    } else if(linkUp()) {
         if(modem.query("+CCID") == MODEM_OK) {
             if(strncmp(modem.lastResponse(), "+CCID: ", 7) == 0) {
-                return String(&(modem.lastResponse()[7]));
+                copyResponse(iccid, &(modem.lastResponse()[7]), sizeof(iccid));
             }
         }
     }
-    return String("Not available");
+    return String(iccid[0] ? iccid : "Not available");
 }
 
 String Hologram::getIMEI() {
-    if(modem_state != MODEM_STATE_DISCONNECTED) {
-        powerUp();
+    if(imsi[0]) {
+        stats.cache_hits++;
+    } else if(linkUp()) {
         if(modem.command("+CIMI") == MODEM_OK) {
-            return String(&(modem.lastResponse()[0]));
+            copyResponse(imsi, modem.lastResponse(), sizeof(imsi));
         }
     }
-    return String("Not available");
+    return String(imsi[0] ? imsi : "Not available");
 }
 
+//a stale name is kept when the refresh fails
 String Hologram::getNetworkOperator() {
-    if(modem_state != MODEM_STATE_DISCONNECTED) {
-        powerUp();
+    if(net_operator[0] && millis() - operator_time < OPERATOR_TTL_MS) {
+        stats.cache_hits++;
+    } else if(linkUp()) {
         if(modem.set("+UDOPN", "12") == MODEM_OK) {
             if(strncmp(modem.lastResponse(), "+UDOPN: 12,\"", 12) == 0) {
-                String s = String(&(modem.lastResponse()[12]));
-                s.remove(s.length()-1);
-                return s;
+                copyResponse(net_operator, &(modem.lastResponse()[12]), sizeof(net_operator));
+                char *quote = strchr(net_operator, '"');
+                if(quote) *quote = 0;
+                operator_time = millis();
             }
         }
     }
-    return String("Not available");
+    return String(net_operator[0] ? net_operator : "Not available");
 }
 
 bool Hologram::getLocation(int accuracy, int maxseconds) {
     //AT+ULOC=2,2,0,360,10
     //AT+HLOC=360,10
-    if(modem_state == MODEM_STATE_DISCONNECTED) return false;
-    powerUp();
+    if(!linkUp()) return false;
     modem.startSet("+HLOC");
     modem.appendSet(maxseconds);
     modem.appendSet(",");
@@ -411,44 +736,151 @@ bool Hologram::setLED(bool on) {
     return false;
 }
 
-void Hologram::powerUp() {
-    int retries = 30;
-    int delayinc = 0;
-    if(modem_state == MODEM_STATE_READY) {
-        return;
-    } else if(modem_state == MODEM_STATE_SHUTDOWN) {
+//starts waking the modem when it was shut down, never waits on it
+bool Hologram::linkUp() {
+    if(!ready) return false;
+    if(modem_state == MODEM_STATE_SHUTDOWN) {
+        stats.reconnects++;
         protocol_version = 0;
-        modem.command("", 150); //pulse an AT but don't expect a response
-        modem_state = MODEM_STATE_UNKNOWN;
-    } else if(modem_state == MODEM_STATE_DISCONNECTED) {
-        if(modem.command("+HCONNECT") == MODEM_OK)
-            modem_state = MODEM_STATE_READY;
+        sent_count = -1;
+        sms_check = true;
+        invalidateStatus();
+        invalidateIdentity();
+        startProbing(); //the first AT is the wake up pulse
     }
-    while(protocol_version == 0) {
+    //callers spinning on linkUp keep the connection manager moving
+    if(!isModemReady()) {
         modem.checkURC();
-        if(modem.command("", 100, retries) != MODEM_OK) {
-            resetSystem();
-            Dash.snooze(1000+(delayinc*2000));
-            retries *= 2;
-            delayinc++;
-        } else if(protocol_version == 0) {
-            if(modem.query("+HOLO", 100, 10) == MODEM_OK) {
-                sscanf(modem.lastResponse(), "+HOLO: %d", &protocol_version);
-            } else {
-                resetSystem();
-                Dash.snooze(3000);
-                modem_state = MODEM_STATE_UNKNOWN;
-            }
+        checkConnection();
+    }
+    //a probe overtaken by +HHOLO still holds the modem queue
+    return isModemReady();
+}
+
+bool Hologram::powerUp(uint32_t timeout) {
+    if(!ready) return false;
+    if(modem_state == MODEM_STATE_DISCONNECTED) {
+        modem_state = MODEM_STATE_CONNECTING;
+        link_backoffs = 0;
+        link_at = millis();
+    }
+    uint32_t start = millis();
+    while(!linkUp() && millis() - start < timeout);
+    return isModemReady();
+}
+
+void Hologram::startProbing() {
+    modem_state = MODEM_STATE_PROBING;
+    link_probes = 0;
+    link_backoffs = 0;
+    link_holo = false;
+    link_at = millis();
+}
+
+void Hologram::probeFailed() {
+    stats.probe_failures++;
+    link_holo = false;
+    if(++link_probes < LINK_PROBES) {
+        link_at = millis();
+        return;
+    }
+    resetSystem();
+    modem_state = MODEM_STATE_RESETTING;
+    linkBackoff();
+}
+
+//exponential with the upper half jittered
+void Hologram::linkBackoff() {
+    uint32_t ms = LINK_BACKOFF_MAX_MS;
+    uint32_t step = LINK_BACKOFF_MS;
+    if(link_backoffs < 16 && (step << link_backoffs) < ms)
+        ms = step << link_backoffs;
+    link_backoffs++;
+    link_jitter ^= link_jitter << 13;
+    link_jitter ^= link_jitter >> 17;
+    link_jitter ^= link_jitter << 5;
+    link_at = millis() + ms/2 + link_jitter % (ms/2 + 1);
+}
+
+void Hologram::linkReady() {
+    modem_state = MODEM_STATE_READY;
+    link_probes = 0;
+    link_backoffs = 0;
+    link_holo = false;
+}
+
+void Hologram::linkStep(modem_result r, const char* response, void *context) {
+    Hologram *h = (Hologram*)context;
+    h->link_pending = false;
+    switch(h->modem_state) {
+    case MODEM_STATE_PROBING:
+        if(r != MODEM_OK) {
+            h->probeFailed();
+        } else if(h->link_holo) {
+            if(h->response_fields.parse(response) && h->response_fields.is("+HOLO") && h->response_fields.count() > 0)
+                h->protocol_version = h->response_fields.toInt(0);
+            if(h->protocol_version != 0)
+                h->linkReady();
+            else
+                h->probeFailed();
+        } else if(h->protocol_version != 0) {
+            h->linkReady(); //+HOLO arrived on its own
+        } else {
+            h->link_holo = true;
         }
         break;
+    case MODEM_STATE_CONNECTING:
+        h->invalidateStatus();
+        if(r == MODEM_OK)
+            h->linkReady();
+        else
+            h->linkBackoff();
+        break;
+    default:
+        break; //powered down or disconnected meanwhile
     }
+}
 
-    modem_state = MODEM_STATE_READY;
+//advance the connection manager, one step in flight at a time
+void Hologram::checkConnection() {
+    if(link_pending || (int32_t)(millis() - link_at) < 0) return;
+    modem_result r;
+    link_pending = true; //the step may complete inside submit
+    switch(modem_state) {
+    case MODEM_STATE_RESETTING:
+        modem_state = MODEM_STATE_PROBING;
+        link_probes = 0;
+        //fall through
+    case MODEM_STATE_PROBING:
+        if(link_holo)
+            r = modem.submitQuery("+HOLO", linkStep, this, LINK_PROBE_MS);
+        else
+            r = modem.submitCommand("", linkStep, this, LINK_PROBE_MS);
+        break;
+    case MODEM_STATE_CONNECTING:
+        stats.reconnects++;
+        r = modem.submitCommand("+HCONNECT", linkStep, this);
+        break;
+    default:
+        link_pending = false;
+        return;
+    }
+    //a full modem queue is tried again next poll
+    if(r != MODEM_OK)
+        link_pending = false;
 }
 
 void Hologram::powerDown() {
     pollEvents();
+    //shutting down now would lose the message being sent, a stream
+    //that was never ended is abandoned
+    if(isStreaming())
+        finishSend(false);
+    waitSend();
     modem_state = MODEM_STATE_SHUTDOWN;
+    //let a probe or +HCONNECT still queued run out first
+    while(modem.queuedCommands() > 0)
+        modem.checkURC();
     modem.command("+HSHUTDOWN");
     protocol_version = 0;
 }
@@ -461,28 +893,89 @@ void Hologram::notifySMS() {
     }
 }
 
+//only talks to the system processor after +HHSMSRX. +HSMS? and +HSMSRD go
+//through the modem queue and the message arrives with +HHSMSCTX, a failed
+//step leaves the check pending for the next poll
+void Hologram::checkSMSPending() {
+    if(sms_state == SMS_CONTENT) {
+        if(sms_pending) {
+            notifySMS();
+            sms_state = SMS_IDLE;
+            sms_check = true; //there may be more
+        } else if(millis() - sms_start >= 1000) {
+            sms_state = SMS_IDLE;
+            sms_check = true;
+        }
+        return;
+    }
+    if(sms_state != SMS_IDLE && sms_result == MODEM_BUSY) return;
+
+    modem_result r = sms_result;
+    switch(sms_state) {
+    case SMS_IDLE:
+        if(!sms_check || modem_state != MODEM_STATE_READY || modem.queuedCommands() > 0) return;
+        sms_check = false;
+        sms_state = SMS_QUERY;
+        sms_result = MODEM_BUSY;
+        if(modem.submitQuery("+HSMS", smsStep, this) != MODEM_OK)
+            sms_result = MODEM_ERROR;
+        break;
+    case SMS_QUERY:
+        sms_state = SMS_IDLE;
+        if(r != MODEM_OK || sms_count < 0) {
+            sms_check = true;
+        } else if(sms_count > 0) {
+            sms_state = SMS_READ;
+            sms_result = MODEM_BUSY;
+            if(modem.submitCommand("+HSMSRD", smsStep, this) != MODEM_OK)
+                sms_result = MODEM_ERROR;
+        }
+        break;
+    case SMS_READ:
+        if(r == MODEM_OK) {
+            //+HHSMSCTX follows the OK, it may already be in
+            sms_state = SMS_CONTENT;
+            sms_start = millis();
+        } else {
+            sms_state = SMS_IDLE;
+            sms_check = true;
+        }
+        break;
+    default:
+        sms_state = SMS_IDLE;
+        break;
+    }
+}
+
+void Hologram::smsStep(modem_result r, const char* response, void *context) {
+    Hologram *h = (Hologram*)context;
+    if(h->sms_state == SMS_QUERY && r == MODEM_OK) {
+        //+HSMS: count
+        const char* p = strchr(response, ':');
+        h->sms_count = p ? atoi(p+1) : -1;
+    }
+    h->sms_result = r;
+}
+
 void Hologram::pollEvents() {
     //check SMS pending...
     if(ready) {
         notifySMS(); //clear any SMS already received
         modem.checkURC();
+        checkConnection();
+        checkClockSync();
         checkIncoming();
-        while(checkSMS() > 0) {
-            if(modem.command("+HSMSRD") == MODEM_OK) {
-                uint32_t startMillis = millis();
-                while (!sms_pending && (millis() - startMillis < 1000)) {
-                    modem.checkURC();
-                }
-                if(!sms_pending) break;
-                notifySMS();
-            } else {
-                break;
-            }
-        }
+        checkSMSPending();
+        checkSend();
+        checkBatch();
+        checkQueue();
+        checkWindow();
     }
 }
 
 size_t Hologram::write(uint8_t x) {
+    if(isStreaming()) return streamWrite(&x, 1);
+    if(batching || isSending()) return 0; //the buffer holds framed records or is being sent
     resetBuffer();
     if(message_length < MAX_MESSAGE_SIZE) {
         message_buffer[message_length++] = x;
@@ -491,21 +984,113 @@ size_t Hologram::write(uint8_t x) {
     return 0;
 }
 
+size_t Hologram::write(const uint8_t *buffer, size_t size) {
+    if(isStreaming()) return streamWrite(buffer, size);
+    if(batching || isSending()) return 0;
+    resetBuffer();
+    if(size > MAX_MESSAGE_SIZE - message_length)
+        size = MAX_MESSAGE_SIZE - message_length;
+    memcpy(&message_buffer[message_length], buffer, size);
+    message_length += size;
+    return size;
+}
+
 bool Hologram::attachTopic(const char* topic) {
-    if(strlen(topic) > MAX_TOPIC_SIZE) return false;
+    if(strlen(topic) > MAX_TOPIC_SIZE || isSending()) return false;
+    resetBuffer();
+    return insertTopic(topic, num_topics) >= 0;
+}
+
+bool Hologram::attachStickyTopic(const char* topic) {
+    if(strlen(topic) > MAX_TOPIC_SIZE || isSending()) return false;
     resetBuffer();
-    if(num_topics == MAX_TOPICS) return false;
-    strcpy(topics[num_topics++], topic);
+    int i = insertTopic(topic, num_sticky);
+    if(i < 0) return false;
+    if(i == (int)num_sticky) num_sticky++;
     return true;
 }
 
+void Hologram::clearStickyTopics() {
+    if(isSending()) return;
+    memmove(topics, &topics[num_sticky], (num_topics - num_sticky)*sizeof(topics[0]));
+    num_topics -= num_sticky;
+    num_sticky = 0;
+}
+
+//add a topic at position unless it is already attached ahead of it,
+//returns where the topic ends up or -1
+int Hologram::insertTopic(const char* topic, uint32_t position) {
+    int offset = internTopic(topic);
+    if(offset < 0) return -1;
+    uint32_t i = 0;
+    while(i < num_topics && topics[i] != offset) i++;
+    if(i < position) return i;
+    if(i == num_topics) {
+        if(num_topics == MAX_TOPICS) return -1;
+        num_topics++;
+    }
+    memmove(&topics[position+1], &topics[position], (i - position)*sizeof(topics[0]));
+    topics[position] = offset;
+    return position;
+}
+
+//offset of topic in the pool, added if it is not there yet
+int Hologram::internTopic(const char* topic) {
+    uint32_t length = strlen(topic) + 1;
+    for(uint32_t i=0; i<topic_pool_length; i+=strlen(&topic_pool[i]) + 1) {
+        if(strcmp(&topic_pool[i], topic) == 0) return i;
+    }
+    if(topic_pool_length + length > TOPIC_POOL_SIZE) compactTopics();
+    if(topic_pool_length + length > TOPIC_POOL_SIZE) return -1;
+    memcpy(&topic_pool[topic_pool_length], topic, length);
+    topic_pool_length += length;
+    return topic_pool_length - length;
+}
+
+//drop pooled topics that are neither attached nor held by the system processor
+void Hologram::compactTopics() {
+    uint32_t w = 0;
+    uint32_t i = 0;
+    while(i < topic_pool_length) {
+        uint32_t length = strlen(&topic_pool[i]) + 1;
+        bool used = false;
+        for(uint32_t t=0; t<num_topics; t++) {
+            if(topics[t] == i) {
+                topics[t] = w;
+                used = true;
+            }
+        }
+        for(int32_t t=0; t<sent_count; t++) {
+            if(sent_topics[t] == i) {
+                sent_topics[t] = w;
+                used = true;
+            }
+        }
+        if(used) {
+            memmove(&topic_pool[w], &topic_pool[i], length);
+            w += length;
+        }
+        i += length;
+    }
+    topic_pool_length = w;
+}
+
+//true when the system processor still holds exactly the attached topics
+bool Hologram::topicsSent() {
+    return topic_reuse && topic_keep >= 0 && sent_count > 0 && (uint32_t)sent_count == num_topics &&
+           memcmp(sent_topics, topics, num_topics*sizeof(topics[0])) == 0;
+}
+
+//sticky topics stay attached
 void Hologram::clear() {
-    num_topics = 0;
+    if(isSending()) return;
+    num_topics = num_sticky;
     message_length = 0;
 }
 
 bool Hologram::sendFinalize(bool success) {
-    message_attempted = true;
+    if(!success) stats.message_failures++;
+    if(!send_queued) message_attempted = true;
     return success;
 }
 
@@ -517,40 +1102,614 @@ void Hologram::resetBuffer() {
 }
 
 bool Hologram::sendMessage() {
-    message_attempted = false;
-    if(modem_state == MODEM_STATE_DISCONNECTED) return sendFinalize(false);;
-    powerUp();
+    if(isSending()) return false;
+    //a queued message from the outbox goes first
+    waitSend();
+    if(!sendMessageAsync()) return false;
+    send_blocking = true;
+    waitSend();
+    return send_success;
+}
+
+//+HMRST, the topics, +HMWRITE chunks and +HMSEND as a state machine
+//advanced by checkSend. With topic reuse on and the topics the system
+//processor already holds, +HMRST=1 resets only the payload and the
+//+HTOPICs are skipped.
+bool Hologram::sendMessageAsync() {
+    if(sendBusy()) return false;
+    send_queued = false;
+    send_streaming = false;
+    return startSend();
+}
+
+//drops anything buffered, the topic is attached along with the sticky ones
+bool Hologram::beginMessage(const char* topic) {
+    if(isSending() || batching) return false;
+    waitSend();
+    clear();
+    if(topic && !attachTopic(topic)) return false;
+    send_queued = false;
+    send_streaming = true;
+    if(!startSend()) return false;
+    while(isSending() && !isStreaming()) {
+        modem.checkURC();
+        checkSend();
+    }
+    return isStreaming();
+}
+
+bool Hologram::endMessage() {
+    if(!isStreaming()) return false;
+    bool ok = send_ok && (send_position == 0 || sendData(send_chunk, send_position));
+    send_position = 0;
+    if(!ok) {
+        finishSend(false);
+        return false;
+    }
+    send_state = SEND_COMMIT;
+    send_start = millis();
+    submitSend("+HMSEND", NULL, 3*60*1000);
+    waitSend();
+    return send_success;
+}
+
+//buffer a chunk at a time, a failed +HMWRITE fails the rest of the stream
+size_t Hologram::streamWrite(const uint8_t* data, size_t size) {
+    size_t written = 0;
+    while(send_ok && written < size) {
+        uint32_t n = writeChunkSize() - send_position;
+        if(n > size - written) n = size - written;
+        memcpy(&send_chunk[send_position], &data[written], n);
+        send_position += n;
+        written += n;
+        if(send_position >= writeChunkSize()) {
+            send_ok = sendData(send_chunk, send_position);
+            send_position = 0;
+        }
+    }
+    return send_ok ? written : 0;
+}
+
+void Hologram::waitSend() {
+    while(sendBusy() && !isStreaming()) {
+        modem.checkURC();
+        checkSend();
+    }
+}
 
-    if(modem.command("+HMRST") != MODEM_OK)
+bool Hologram::startSend() {
+    if(!send_queued) message_attempted = false;
+    send_blocking = false;
+    stats.messages++;
+    if(!linkUp())
         return sendFinalize(false);
 
-    for(int i=0; i<num_topics; i++) {
-        if(protocol_version >= 2)
-            modem.set("+HTOPIC", topics[i]);
-        else
-            modem.set("+HTAG", topics[i]);
+    send_state = SEND_RESET;
+    send_result = MODEM_BUSY;
+    send_kept = !send_queued && topicsSent();
+    send_success = false;
+    if(send_kept) {
+        submitSend("+HMRST", "1");
+    } else {
+        sent_count = -1;
+        submitSend("+HMRST");
     }
+    return true;
+}
 
-    uint32_t length = message_length;
+void Hologram::sendStep(modem_result r, const char* response, void *context) {
+    ((Hologram*)context)->send_result = r;
+}
 
-    uint32_t wrcount = 0;
-    while(length > 0) {
-        int tosend = length;
-        if(tosend > 128) tosend = 128;
-        modem.startSet("+HMWRITE");
-        modem.appendSet(tosend);
-        if(modem.intermediateSet('@', 10000) == MODEM_OK) {
-            for(int i=0; i<tosend; i++)
-                modem.dataWrite(message_buffer[wrcount++]);
+//queue a step of the send, commands too long for the modem queue are sent blocking
+void Hologram::submitSend(const char* cmd, const char* value, uint32_t timeout) {
+    modem_result r;
+    if(value)
+        r = modem.submitSet(cmd, value, sendStep, this, timeout);
+    else
+        r = modem.submitCommand(cmd, sendStep, this, timeout);
+    if(r != MODEM_OK) {
+        r = value ? modem.set(cmd, value, timeout) : modem.command(cmd, timeout);
+        send_result = r == MODEM_BUSY ? MODEM_ERROR : r;
+    }
+}
+
+//advance the send in progress as far as it goes without waiting
+void Hologram::checkSend() {
+    while(send_state != SEND_IDLE && send_result != MODEM_BUSY) {
+        modem_result r = send_result;
+        send_result = MODEM_BUSY;
+        switch(send_state) {
+        case SEND_RESET:
+            if(send_kept) {
+                send_kept = false;
+                if(r == MODEM_OK) {
+                    topic_keep = 1;
+                    stats.topics_reused++;
+                    beginWrite();
+                    break;
+                }
+                //firmware without +HMRST=1, fall back to the full sequence
+                if(r == MODEM_ERROR && topic_keep == 0) topic_keep = -1;
+                sent_count = -1;
+                submitSend("+HMRST");
+            } else if(r == MODEM_OK) {
+                sent_count = 0;
+                send_index = 0;
+                send_ok = true;
+                sendNextTopic();
+            } else {
+                finishSend(false);
+            }
+            break;
+        case SEND_TOPICS:
+            if(r != MODEM_OK) send_ok = false;
+            sendNextTopic();
+            break;
+        case SEND_WRITE:
+            if(send_write_length) {
+                uint32_t n = send_write_length;
+                send_write_length = 0;
+                if(r == MODEM_OK) {
+                    send_position += n;
+                    stats.write_bytes += n;
+                } else if(r == MODEM_ERROR && send_position == 0 && writeChunkSize() > HMWRITE_CHUNK_V1) {
+                    //the system processor refused the larger chunk, stay at
+                    //the v1 size and start the payload over
+                    write_chunk_limit = HMWRITE_CHUNK_V1;
+                    if(send_compressed) compressor->begin(message_buffer, message_length);
+                } else {
+                    finishSend(false);
+                    break;
+                }
+            }
+            //return after every chunk so the caller gets to run
+            writeNext();
+            return;
+        case SEND_COMMIT: {
+            uint32_t elapsed = millis() - send_start;
+            stats.send_ms += elapsed;
+            if(elapsed > stats.send_max_ms) stats.send_max_ms = elapsed;
+            finishSend(r == MODEM_OK);
+            break;
         }
-        if(modem.waitSetComplete(10000) == MODEM_OK) {
-            length -= tosend;
-        } else {
-            return sendFinalize(false);
+        default:
+            finishSend(false);
+            break;
         }
     }
+}
 
-    return sendFinalize(modem.command("+HMSEND", 3*60*1000) == MODEM_OK);
+void Hologram::sendNextTopic() {
+    const char* cmd = protocol_version >= 2 ? "+HTOPIC" : "+HTAG";
+    if(send_queued) {
+        //read back from the record, nul separated
+        char t[MAX_TOPIC_SIZE+1];
+        uint32_t n = 0;
+        if(send_index < send_topics_length && outbox.headSeq() == send_seq)
+            n = outbox.read(send_index, t, sizeof(t));
+        if(n > 0) {
+            t[n-1] = 0;
+            send_index += strlen(t) + 1;
+            send_state = SEND_TOPICS;
+            submitSend(cmd, t);
+            return;
+        }
+        sent_count = -1; //not a set from the topic pool
+        beginWrite();
+        return;
+    }
+    if(send_index < num_topics) {
+        send_state = SEND_TOPICS;
+        submitSend(cmd, topic(send_index++));
+        return;
+    }
+    if(send_ok) {
+        memcpy(sent_topics, topics, num_topics*sizeof(topics[0]));
+        sent_count = num_topics;
+    }
+    beginWrite();
+}
+
+//the payload goes through the compressor when that makes it smaller,
+//the LZSS header tells the cloud side to expand it
+void Hologram::beginWrite() {
+    send_position = 0;
+    send_write_length = 0;
+    send_compressed = false;
+    if(send_streaming) {
+        send_state = SEND_STREAM;
+        send_ok = true;
+        return;
+    }
+    send_state = SEND_WRITE;
+    send_result = MODEM_OK;
+    if(send_queued) return; //send_size is the record body
+    send_size = message_length;
+    if(compressor && message_length >= COMPRESS_MIN_LENGTH && compressor->begin(message_buffer, message_length)) {
+        uint32_t size = compressor->measure();
+        if(size < message_length) {
+            send_compressed = true;
+            send_size = size;
+        }
+    }
+    send_result = MODEM_OK;
+}
+
+//submits the next +HMWRITE, checkSend takes its result
+void Hologram::writeNext() {
+    const uint8_t *data = send_chunk;
+    uint32_t n = 0;
+    bool ok = true;
+    if(send_position >= send_size) {
+        //all written
+    } else if(send_queued) {
+        //a full outbox may have overwritten the record meanwhile
+        n = send_size - send_position;
+        if(n > writeChunkSize()) n = writeChunkSize();
+        ok = outbox.headSeq() == send_seq &&
+             outbox.read(send_topics_length + send_position, send_chunk, n) == n;
+    } else if(send_compressed) {
+        n = compressor->read(send_chunk, writeChunkSize());
+    } else if(send_blocking) {
+        //a caller that waits anyway lets writeChunked pipeline the chunks
+        n = message_length - send_position;
+        ok = sendData(&message_buffer[send_position], n);
+        send_position += n;
+        n = 0;
+    } else {
+        n = message_length - send_position;
+        if(n > writeChunkSize()) n = writeChunkSize();
+        data = &message_buffer[send_position];
+    }
+
+    if(!ok) {
+        finishSend(false);
+    } else if(n > 0) {
+        send_write_length = n;
+        if(modem.submitWrite("+HMWRITE", data, n, sendStep, this) != MODEM_OK) {
+            //the modem queue is full, write this one blocking
+            send_write_length = 0;
+            if(sendData(data, n)) {
+                send_position += n;
+                send_result = MODEM_OK;
+            } else {
+                finishSend(false);
+            }
+        }
+    } else {
+        send_state = SEND_COMMIT;
+        send_start = millis();
+        submitSend("+HMSEND", NULL, 3*60*1000);
+    }
+}
+
+void Hologram::finishSend(bool success) {
+    send_state = SEND_IDLE;
+    send_success = success;
+    if(success && send_compressed) {
+        stats.compressed++;
+        stats.compress_saved += message_length - send_size;
+    }
+    sendFinalize(success);
+    if(send_queued) {
+        finishQueued(success);
+        return;
+    }
+    if(batch_flushing) {
+        batch_flushing = false;
+        batchSent(success);
+    }
+    if(sent_callback)
+        sent_callback(success);
+}
+
+bool Hologram::sendData(const uint8_t* data, uint32_t length) {
+    uint32_t written = 0;
+    modem_result r = modem.writeChunked("+HMWRITE", data, length, writeChunkSize(), &written);
+    if(r == MODEM_ERROR && written == 0 && writeChunkSize() > HMWRITE_CHUNK_V1) {
+        //the system processor refused the larger chunk, stay at the v1 size
+        write_chunk_limit = HMWRITE_CHUNK_V1;
+        r = modem.writeChunked("+HMWRITE", data, length, writeChunkSize(), &written);
+    }
+    stats.write_bytes += written;
+    return r == MODEM_OK;
+}
+
+uint32_t Hologram::writeChunkSize() {
+    uint32_t chunk = protocol_version >= 2 ? HMWRITE_CHUNK_V2 : HMWRITE_CHUNK_V1;
+    if(write_chunk_limit && write_chunk_limit < chunk)
+        chunk = write_chunk_limit;
+    return chunk;
+}
+
+void Hologram::resetStats() {
+    memset(&stats, 0, sizeof(stats));
+    modem.resetStats();
+}
+
+bool Hologram::beginQueue(uint32_t address, uint32_t size) {
+    outbox_failures = 0;
+    outbox_backoff = false;
+    return outbox.begin(DashFlash, address, size);
+}
+
+void Hologram::endQueue() {
+    outbox.end();
+    windows = false;
+    window_open = false;
+}
+
+bool Hologram::beginWindows(uint32_t period, uint32_t max_length, uint32_t early_count) {
+    if(!outbox.ready() || period == 0) return false;
+    windows = true;
+    window_open = false;
+    window_period = period;
+    window_max = max_length;
+    window_early = early_count;
+    window_left = 0;
+    //due now: anything queued before a reset goes out, otherwise the
+    //modem is shut down until the first window
+    window_next = Clock.counter();
+    memset(&window_stats, 0, sizeof(window_stats));
+    return true;
+}
+
+//the modem is left as it is, queued messages go out whenever it is connected
+void Hologram::endWindows() {
+    windows = false;
+    window_open = false;
+}
+
+uint32_t Hologram::secondsToWindow() {
+    if(!windows || window_open) return 0;
+    int32_t s = (int32_t)(window_next - Clock.counter());
+    return s > 0 ? s : 0;
+}
+
+void Hologram::checkWindow() {
+    if(!windows) return;
+    if(window_open) {
+        if(millis() - window_sample >= TX_WINDOW_SAMPLE_MS)
+            sampleBattery();
+        //let the send in flight and queries like a clock sync finish
+        if(sendBusy() || modem.queuedCommands() > 0) return;
+        if(outbox.count() == 0 || millis() - window_start >= window_max*1000)
+            closeWindow();
+        return;
+    }
+    //early only counts what was queued since the last window gave up
+    bool early = window_early && outbox.count() >= window_left + window_early;
+    if(!early && (int32_t)(Clock.counter() - window_next) < 0) return;
+    if(outbox.count() > 0) {
+        openWindow();
+        return;
+    }
+    window_stats.skipped++;
+    scheduleWindow();
+    //woken outside a window, by begin() or a query
+    if(modem_state != MODEM_STATE_SHUTDOWN)
+        powerDown();
+}
+
+void Hologram::openWindow() {
+    window_open = true;
+    window_stats.windows++;
+    window_removed = outbox.getStats().removed;
+    //resting voltage, before the modem draws anything
+    window_soc = FuelGauge.soc();
+    window_stats.start_mv = FuelGauge.mv();
+    window_stats.min_mv = window_stats.start_mv;
+    window_start = window_sample = millis();
+    outbox_backoff = false;
+    powerUp(0);
+}
+
+void Hologram::closeWindow() {
+    window_open = false; //powerDown polls, this must not close again
+    window_left = outbox.count();
+    if(window_left > 0) window_stats.timeouts++;
+    window_stats.sent = outbox.getStats().removed - window_removed;
+    scheduleWindow();
+    sampleBattery(); //still under load
+    powerDown();
+
+    window_stats.on_ms = millis() - window_start;
+    window_stats.total_on_ms += window_stats.on_ms;
+    //1/256% of capacity is 39.0625ppm, negative while charging
+    window_stats.charge_ppm = ((int32_t)window_soc - FuelGauge.soc()) * 625 / 16;
+    window_stats.total_charge_ppm += window_stats.charge_ppm;
+}
+
+void Hologram::sampleBattery() {
+    uint32_t mv = FuelGauge.mv();
+    if(mv < window_stats.min_mv) window_stats.min_mv = mv;
+    window_sample = millis();
+}
+
+//keep the cadence unless windows fell a period behind it, an early
+//window stands in for the next one
+void Hologram::scheduleWindow() {
+    uint32_t now = Clock.counter();
+    int32_t late = (int32_t)(now - window_next);
+    if(late >= 0 && late < (int32_t)window_period)
+        window_next += window_period;
+    else
+        window_next = now + window_period;
+}
+
+//store the buffered message and its topics in flash, sent later by pollEvents
+bool Hologram::queueMessage() {
+    if(isSending()) return false;
+    const char* list[MAX_TOPICS];
+    for(uint32_t i=0; i<num_topics; i++) {
+        list[i] = topic(i);
+    }
+    message_attempted = true;
+    return outbox.push(list, num_topics, message_buffer, message_length);
+}
+
+bool Hologram::queueMessage(const char* content, const char* topic) {
+    return queueMessage((const uint8_t*)content, strlen(content), topic);
+}
+
+bool Hologram::queueMessage(const uint8_t* content, uint32_t length, const char* topic) {
+    if(isSending() || batching) return false; //would overwrite the open batch
+    resetBuffer();
+    if(topic)
+        attachTopic(topic);
+
+    if(length+message_length > MAX_MESSAGE_SIZE) {
+        length = MAX_MESSAGE_SIZE - message_length;
+    }
+    memcpy(&message_buffer[message_length], content, length);
+    message_length += length;
+
+    return queueMessage();
+}
+
+//send up to max queued messages now, -1 for all, returns the number sent
+int Hologram::flushQueue(int max) {
+    int sent = 0;
+    if(isSending()) return 0;
+    waitSend();
+    while(sent != max && outbox.count() > 0 && startQueued()) {
+        waitSend();
+        if(!send_success) break;
+        sent++;
+    }
+    return sent;
+}
+
+//start sending the oldest queued message straight out of flash through
+//the send state machine, leaving the message buffer alone so a sketch can
+//still re-send its last message
+bool Hologram::startQueued() {
+    uint32_t topics_length = 0;
+    int32_t length = outbox.peek(&topics_length);
+    if(length < 0) return false;
+    send_queued = true;
+    send_streaming = false;
+    send_seq = outbox.headSeq();
+    send_topics_length = topics_length;
+    send_size = length - topics_length;
+    return startSend();
+}
+
+void Hologram::finishQueued(bool success) {
+    //an overwritten record was already dropped by the outbox
+    if(outbox.headSeq() == send_seq) {
+        if(success) {
+            outbox.pop();
+            outbox_failures = 0;
+        } else if(isConnected() && ++outbox_failures >= MESSAGE_QUEUE_ATTEMPTS) {
+            //a message the cloud keeps refusing must not block the ones behind it
+            outbox.pop(false);
+            outbox_failures = 0;
+        }
+    }
+    outbox_backoff = !success;
+    outbox_retry = millis();
+}
+
+//starts the oldest record, the send itself runs from checkSend
+void Hologram::checkQueue() {
+    if(outbox.count() == 0 || modem_state != MODEM_STATE_READY || sendBusy()) return;
+    if(windows && !window_open) return;
+    //let async queries finish first instead of waiting on them
+    if(modem.queuedCommands() > 0) return;
+    if(outbox_backoff && millis() - outbox_retry < MESSAGE_QUEUE_RETRY_MS) return;
+    if(!isConnected() || !startQueued()) {
+        outbox_backoff = true;
+        outbox_retry = millis();
+    }
+}
+
+bool Hologram::beginBatch(const char* topic, uint32_t max_age, uint32_t max_size) {
+    if(isSending()) return false;
+    if(batching) endBatch();
+    clear();
+    message_attempted = false;
+    if(topic && !attachTopic(topic)) return false;
+    batching = true;
+    batch_records = 0;
+    batch_flushing = false;
+    batch_age = max_age;
+    batch_size = (max_size == 0 || max_size > MAX_MESSAGE_SIZE) ? MAX_MESSAGE_SIZE : max_size;
+    return true;
+}
+
+bool Hologram::addRecord(const uint8_t* data, uint32_t length) {
+    if(!batching || isSending()) return false;
+
+    uint8_t prefix[5];
+    uint32_t n = 0;
+    uint32_t v = length;
+    do {
+        prefix[n] = v & 0x7F;
+        v >>= 7;
+        if(v) prefix[n] |= 0x80;
+        n++;
+    } while(v);
+
+    if(n + length > batch_size) return false;
+    if(message_length + n + length > batch_size && !flushBatch()) return false;
+
+    if(batch_records == 0) batch_start = millis();
+    memcpy(&message_buffer[message_length], prefix, n);
+    memcpy(&message_buffer[message_length+n], data, length);
+    message_length += n + length;
+    batch_records++;
+    stats.records++;
+    checkBatch();
+    return true;
+}
+
+//send the open batch, through the outbox when it is running. On failure
+//the records are kept and retried once the batch ages out again
+bool Hologram::flushBatch() {
+    if(!batching) return false;
+    if(batch_flushing) waitSend();
+    if(batch_records == 0) return true;
+    bool sent = (outbox.ready() && queueMessage()) || sendMessage();
+    batchSent(sent);
+    return sent;
+}
+
+void Hologram::batchSent(bool sent) {
+    message_attempted = false;
+    if(sent) {
+        message_length = 0;
+        batch_records = 0;
+    } else {
+        batch_start = millis();
+    }
+}
+
+//flush and close the batch, an unsent batch stays buffered for sendMessage()
+bool Hologram::endBatch() {
+    if(!batching) return false;
+    bool sent = flushBatch();
+    batching = false;
+    batch_records = 0;
+    if(sent)
+        clear();
+    message_attempted = true;
+    return sent;
+}
+
+//an aged batch goes out without waiting on the modem, finishSend clears it
+void Hologram::checkBatch() {
+    if(!batching || batch_records == 0 || !batch_age || millis() - batch_start < batch_age || sendBusy()) return;
+    if(outbox.ready() && queueMessage()) {
+        batchSent(true);
+        return;
+    }
+    batch_flushing = true;
+    if(!sendMessageAsync()) {
+        batch_flushing = false;
+        batchSent(false);
+    }
 }
 
 bool Hologram::sendMessage(const String &content) {
@@ -578,6 +1737,7 @@ bool Hologram::sendMessage(const char* content, const String &topic) {
 }
 
 bool Hologram::sendMessage(const uint8_t* content, uint32_t length) {
+    if(isSending() || batching) return false;
     resetBuffer();
 
     if(length+message_length > MAX_MESSAGE_SIZE) {
@@ -594,6 +1754,7 @@ bool Hologram::sendMessage(const uint8_t* content, uint32_t length, const String
 }
 
 bool Hologram::sendMessage(const uint8_t* content, uint32_t length, const char* topic) {
+    if(batching) return false;
     if(topic)
         attachTopic(topic);
     return sendMessage(content, length);
@@ -23,11 +23,133 @@
 
 #include "Print.h"
 #include "system/hal/ArduinoModem.h"
+#include "system/sdk/network/modem/URCTable.h"
+#include "MessageQueue.h"
+#include "CBOREncoder.h"
+#include "system/sdk/compress/LZSS.h"
 #include "hal/fsl_rtc_hal.h"
 
+//sketches that only stream messages can shrink the buffer
+#ifndef MAX_MESSAGE_SIZE
 #define MAX_MESSAGE_SIZE 4096
+#endif
 #define MAX_TOPIC_SIZE 63
 #define MAX_TOPICS 10
+//attached topics are interned into one pool and referenced by offset
+#ifndef TOPIC_POOL_SIZE
+#define TOPIC_POOL_SIZE 256
+#endif
+#define MAX_URC_TABLES 4
+
+//+HMWRITE chunk size by system protocol version, larger chunks mean
+//fewer prompt/OK round trips per message
+#ifndef HMWRITE_CHUNK_V1
+#define HMWRITE_CHUNK_V1 128
+#endif
+#ifndef HMWRITE_CHUNK_V2
+#define HMWRITE_CHUNK_V2 512
+#endif
+
+//store-and-forward outbox, the last 32KB of DashFlash unless placed elsewhere
+#ifndef MESSAGE_QUEUE_ADDRESS
+#define MESSAGE_QUEUE_ADDRESS 0x38000
+#endif
+#ifndef MESSAGE_QUEUE_SIZE
+#define MESSAGE_QUEUE_SIZE 0x8000
+#endif
+//wait between drain attempts after a failure or while offline
+#ifndef MESSAGE_QUEUE_RETRY_MS
+#define MESSAGE_QUEUE_RETRY_MS 10000
+#endif
+//sends of the same record that may fail while connected before it is dropped
+#ifndef MESSAGE_QUEUE_ATTEMPTS
+#define MESSAGE_QUEUE_ATTEMPTS 5
+#endif
+
+//shorter messages are sent as is, the LZSS header and flags would eat the gain
+#ifndef COMPRESS_MIN_LENGTH
+#define COMPRESS_MIN_LENGTH 64
+#endif
+
+//inbound connections tracked at once, extra accepts are closed
+#ifndef INBOUND_SOCKETS
+#define INBOUND_SOCKETS 4
+#endif
+//how long each +HSOCKREAD from pollEvents waits for data
+#ifndef INBOUND_READ_MS
+#define INBOUND_READ_MS 100
+#endif
+//bytes asked for per +HSOCKREAD, the hex reply has to fit a response line
+#ifndef INBOUND_READ_CHUNK
+#define INBOUND_READ_CHUNK 200
+#endif
+//a connection idle this long is delivered and closed
+#ifndef INBOUND_IDLE_MS
+#define INBOUND_IDLE_MS 10000
+#endif
+
+//connection manager: failed AT probes before the system processor is reset,
+//then the wait before probing again, doubled per reset up to the cap
+#ifndef LINK_PROBES
+#define LINK_PROBES 30
+#endif
+#ifndef LINK_PROBE_MS
+#define LINK_PROBE_MS 100
+#endif
+#ifndef LINK_BACKOFF_MS
+#define LINK_BACKOFF_MS 1000
+#endif
+#ifndef LINK_BACKOFF_MAX_MS
+#define LINK_BACKOFF_MAX_MS 60000
+#endif
+//how long begin(), connect() and powerUp() wait for the modem by default
+#ifndef POWER_UP_WAIT_MS
+#define POWER_UP_WAIT_MS 5000
+#endif
+
+//+HCONSTATUS is trusted this long unless a URC reports a change first
+#ifndef CLOUD_STATUS_TTL_MS
+#define CLOUD_STATUS_TTL_MS 30000
+#endif
+//the network operator can change while roaming
+#ifndef OPERATOR_TTL_MS
+#define OPERATOR_TTL_MS 300000
+#endif
+
+//RTC sync from network time. The drift is re-estimated once the RTC has
+//gained or lost this many seconds on the network since the last estimate
+#ifndef CLOCK_SYNC_INTERVAL_S
+#define CLOCK_SYNC_INTERVAL_S 21600
+#endif
+#ifndef CLOCK_SYNC_RETRY_S
+#define CLOCK_SYNC_RETRY_S 60
+#endif
+#ifndef CLOCK_DRIFT_ERROR_S
+#define CLOCK_DRIFT_ERROR_S 4
+#endif
+//more than any crystal drifts, the time was changed behind our back
+#ifndef CLOCK_DRIFT_MAX_PPB
+#define CLOCK_DRIFT_MAX_PPB 500000
+#endif
+
+//transmission windows: queued messages wait for the next window, which
+//powers the modem up once, drains the outbox and shuts the modem down again
+#ifndef TX_WINDOW_PERIOD_S
+#define TX_WINDOW_PERIOD_S 3600
+#endif
+//a window without coverage gives up after this long, the messages stay queued
+#ifndef TX_WINDOW_MAX_S
+#define TX_WINDOW_MAX_S 120
+#endif
+//the battery is read this often while a window is open
+#ifndef TX_WINDOW_SAMPLE_MS
+#define TX_WINDOW_SAMPLE_MS 1000
+#endif
+
+//flush an open batch once its oldest record is this old, 0 to only flush on size
+#ifndef BATCH_MAX_AGE_MS
+#define BATCH_MAX_AGE_MS 60000
+#endif
 
 #define CLOUD_REGISTERED        0
 #define CLOUD_CONNECTED         1
@@ -58,9 +180,47 @@ typedef enum {
     CHARGE_STATUS_NO_INPUT      = 7,
 }charge_status;
 
+typedef struct {
+    uint32_t messages;          //sendMessage calls
+    uint32_t message_failures;
+    uint32_t write_bytes;       //payload bytes accepted by +HMWRITE
+    uint32_t send_ms;           //total time waiting on +HMSEND
+    uint32_t send_max_ms;
+    uint32_t reconnects;        //+HCONNECT or system processor wake ups
+    uint32_t resets;            //resetSystem pulses
+    uint32_t probe_failures;    //AT or +HOLO? probes left unanswered
+    uint32_t cache_hits;        //status or identity answered without a command
+    uint32_t records;           //records added to batches
+    uint32_t compressed;        //messages sent LZSS compressed
+    uint32_t compress_saved;    //payload bytes saved by compression
+    uint32_t topics_reused;     //messages sent without re-sending their topics
+}cloud_stats;
+
+typedef struct {
+    uint32_t syncs;             //network times applied to the RTC
+    uint32_t failures;          //+CCLK failed or had no network time yet
+    uint32_t steps;             //times the RTC was set
+    int32_t last_offset;        //RTC minus network at the last sync, seconds
+    int32_t drift_ppb;          //compensation in use, positive runs the RTC faster
+}clock_sync_stats;
+
+typedef struct {
+    uint32_t windows;           //opened with messages queued
+    uint32_t skipped;           //came due with nothing queued
+    uint32_t timeouts;          //closed with messages still queued
+    uint32_t sent;              //queued messages delivered in the last window
+    uint32_t on_ms;             //modem on time of the last window
+    uint32_t total_on_ms;
+    uint32_t start_mv;          //battery as the last window opened
+    uint32_t min_mv;            //lowest battery reading during it
+    int32_t charge_ppm;         //state of charge the last window used, ppm of capacity
+    int32_t total_charge_ppm;
+}tx_window_stats;
+
 class Hologram : public Print, public URCReceiver {
 public:
     void begin();
+    void begin(Stream &system);
     void end();
 
     bool connect();
@@ -71,9 +231,18 @@ public:
     int getSignalStrength();
     bool getNetworkTime(rtc_datetime_t &dt);
     bool getUTC(rtc_datetime_t &dt);
-
-    void powerUp();
+    //keeps the RTC on UTC from network time, learning the crystal drift
+    //between syncs. Once synced getUTC reads the RTC instead of the modem
+    void beginClockSync(uint32_t interval=CLOCK_SYNC_INTERVAL_S);
+    void endClockSync();
+    bool isClockSynced() {return clock_synced;}
+    const clock_sync_stats& getClockSyncStats() {return clock_stats;}
+
+    //the modem comes up from pollEvents, calls that need it fail while it
+    //does. powerUp waits up to timeout for it, 0 only starts it
+    bool powerUp(uint32_t timeout=POWER_UP_WAIT_MS);
     void powerDown();
+    bool isModemReady() {return modem_state == MODEM_STATE_READY && !link_pending;}
 
     void pollEvents();
 
@@ -114,34 +283,194 @@ public:
 
     bool attachTopic(const char* topic);
     bool attachTopic(const String &topic) {return attachTopic(topic.c_str());}
+    //sticky topics are attached to every message until cleared
+    bool attachStickyTopic(const char* topic);
+    bool attachStickyTopic(const String &topic) {return attachStickyTopic(topic.c_str());}
+    void clearStickyTopics();
+    //send an unchanged topic set to the system processor only once, keeping
+    //it with +HMRST=1. Off by default, needs system firmware that supports it
+    void setTopicReuse(bool enable) {topic_reuse = enable;}
     size_t write(uint8_t x);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
     bool sendMessage();
+    //starts sending the buffered message and returns, the send runs from
+    //pollEvents and ends with the sent handler. The buffer and topics are
+    //locked until then: writes return 0 and other sends fail. It also fails
+    //while the outbox sends a queued message, see sendBusy
+    bool sendMessageAsync();
+    bool isSending() {return send_state != SEND_IDLE && !send_queued;}
+    //a send of either kind in flight, isSending leaves out queued messages
+    bool sendBusy() {return send_state != SEND_IDLE;}
+
+    //streamed messages bypass the message buffer, writes go to the system
+    //processor a chunk at a time so the payload is not limited by RAM
+    bool beginMessage(const char* topic=NULL);
+    bool beginMessage(const String &topic) {return beginMessage(topic.c_str());}
+    bool endMessage();
+    bool isStreaming() {return send_state == SEND_STREAM;}
+
+    bool beginQueue(uint32_t address=MESSAGE_QUEUE_ADDRESS, uint32_t size=MESSAGE_QUEUE_SIZE);
+    void endQueue();
+    bool queueMessage();
+    bool queueMessage(const char* content, const char* topic=NULL);
+    bool queueMessage(const uint8_t* content, uint32_t length, const char* topic=NULL);
+    bool queueMessage(const String &content) {return queueMessage(content.c_str());}
+    bool queueMessage(const String &content, const String &topic) {return queueMessage(content.c_str(), topic.c_str());}
+    int flushQueue(int max=-1);
+    bool isQueueReady() {return outbox.ready();}
+    uint32_t queued() {return outbox.count();}
+    const message_queue_stats& getQueueStats() {return outbox.getStats();}
+    bool clearQueue() {return outbox.clear();}
+
+    //queued messages are only sent in transmission windows every period
+    //seconds, or as soon as early_count are queued when that is not 0.
+    //Between windows the modem is shut down and the sketch can deep sleep
+    //for up to secondsToWindow()
+    bool beginWindows(uint32_t period=TX_WINDOW_PERIOD_S, uint32_t max_length=TX_WINDOW_MAX_S, uint32_t early_count=0);
+    void endWindows();
+    bool isWindowOpen() {return window_open;}
+    uint32_t secondsToWindow();
+    const tx_window_stats& getWindowStats() {return window_stats;}
+
+    //batches pack many small records into one message, each record
+    //prefixed with its length as a base 128 varint
+    //sendMessage and queueMessage with content fail while a batch is open.
+    //A batch that ages out is sent from pollEvents, addRecord fails until
+    //that send ends
+    bool beginBatch(const char* topic=NULL, uint32_t max_age=BATCH_MAX_AGE_MS, uint32_t max_size=MAX_MESSAGE_SIZE);
+    bool addRecord(const uint8_t* data, uint32_t length);
+    bool addRecord(const char* data) {return addRecord((const uint8_t*)data, strlen(data));}
+    bool addRecord(const String &data) {return addRecord(data.c_str());}
+    bool flushBatch();
+    bool endBatch();
+    uint32_t batchRecords() {return batch_records;}
+
+    //compress outgoing messages with a sketch provided LZSS, NULL to stop
+    void setCompressor(LZSS *lzss) {compressor = lzss;}
 
     int listen(int port);
 
     void resetSystem();
 
+    const cloud_stats& getStats() {return stats;}
+    void resetStats();
+
     void attachHandlerSMS(void (*sms_handler)(const String &sender, const rtc_datetime_t &timestamp, const String &message));
     void attachHandlerInbound(void (*inbound_handler)(int length), void *buffer, int length);
+    //buffer is split between INBOUND_SOCKETS connections drained side by side
+    void attachHandlerInbound(void (*inbound_handler)(int socket, const uint8_t *data, int length), void *buffer, int length);
     void attachHandlerNotify(void (*event_handler)(cloud_event e));
     void attachHandlerLocation(void (*location_handler)(const rtc_datetime_t &timestamp, const String &lat, const String &lon, int altitude, int uncertainty));
     void attachHandlerCharge(void (*charge_handler)(charge_status status));
+    void attachHandlerSent(void (*sent_handler)(bool success));
+    bool attachHandlerURC(const urc_entry *table, size_t count, void *context=NULL);
     void onURC(const char* urc);
 
 protected:
+    //below SHUTDOWN the system processor is not known to answer
     typedef enum {
         MODEM_STATE_UNKNOWN,
+        MODEM_STATE_PROBING,        //AT then +HOLO? until it answers
+        MODEM_STATE_RESETTING,      //reset pulsed, backing off before probing again
         MODEM_STATE_SHUTDOWN,
         MODEM_STATE_DISCONNECTED,
+        MODEM_STATE_CONNECTING,     //+HCONNECT, backing off between failures
         MODEM_STATE_READY,
     }state_modem;
 
-    bool getTime(rtc_datetime_t &dt, bool utc);
+    typedef enum {
+        SEND_IDLE,
+        SEND_RESET,         //waiting on +HMRST
+        SEND_TOPICS,        //waiting on a +HTOPIC
+        SEND_WRITE,         //waiting on a +HMWRITE, one chunk in flight
+        SEND_COMMIT,        //waiting on +HMSEND
+        SEND_STREAM,        //between beginMessage and endMessage
+    }state_send;
+
+    typedef enum {
+        SMS_IDLE,
+        SMS_QUERY,          //waiting on +HSMS?
+        SMS_READ,           //waiting on +HSMSRD
+        SMS_CONTENT,        //waiting on +HHSMSCTX
+    }state_sms;
+
+    typedef struct {
+        int id;                 //0 when free
+        int part;               //share of the inbound buffer, -1 while waiting for one
+        int length;
+        uint32_t last;          //accept or last data
+        bool closed;            //the peer closed and everything is read
+    }inbound_socket;
 
+    bool getTime(rtc_datetime_t &dt, bool utc);
+    bool timeResponse(const char* response, rtc_datetime_t &dt, bool utc);
+    void checkClockSync();
+    void syncClock(uint32_t network);
+    void setDrift(int32_t ppb);
+    static bool toDateTime(const ATFields &fields, int i, rtc_datetime_t &dt, int *tz=NULL);
+    bool parseResponse(const char* prefix);
+    void setStatus(int status);
+    void invalidateStatus() {status_cache = -1;}
+    void invalidateIdentity();
+
+    static const urc_entry URCS[];
+    static const size_t NUM_URCS;
+    static void urcCharge(const ATFields &fields, void *context);
+    static void urcConnected(const ATFields &fields, void *context);
+    static void urcLocation(const ATFields &fields, void *context);
+    static void urcHolo(const ATFields &fields, void *context);
+    static void urcRegistered(const ATFields &fields, void *context);
+    static void urcSMSContent(const ATFields &fields, void *context);
+    static void urcSMSReceived(const ATFields &fields, void *context);
+    static void urcSocketAccept(const ATFields &fields, void *context);
+    static void sendStep(modem_result r, const char* response, void *context);
+    static void readStep(modem_result r, const char* response, void *context);
+    static void smsStep(modem_result r, const char* response, void *context);
+    static void linkStep(modem_result r, const char* response, void *context);
+    static void clockStep(modem_result r, const char* response, void *context);
+
+    bool linkUp();
+    void startProbing();
+    void probeFailed();
+    void linkBackoff();
+    void linkReady();
+    void checkConnection();
     bool sendFinalize(bool success);
+    bool sendData(const uint8_t* data, uint32_t length);
+    bool startSend();
+    void waitSend();
+    size_t streamWrite(const uint8_t* data, size_t size);
+    void submitSend(const char* cmd, const char* value=NULL, uint32_t timeout=1000);
+    void sendNextTopic();
+    void beginWrite();
+    void writeNext();
+    void finishSend(bool success);
+    void checkSend();
+    bool startQueued();
+    void finishQueued(bool success);
+    void checkQueue();
+    void checkBatch();
+    void batchSent(bool sent);
+    void checkWindow();
+    void openWindow();
+    void closeWindow();
+    void sampleBattery();
+    void scheduleWindow();
+    uint32_t writeChunkSize();
     void resetBuffer();
+    const char* topic(uint32_t i) {return &topic_pool[topics[i]];}
+    int insertTopic(const char* topic, uint32_t position);
+    int internTopic(const char* topic);
+    void compactTopics();
+    bool topicsSent();
     void checkIncoming();
+    bool acceptSocket(int id);
+    bool assignPart(inbound_socket &s);
+    void deliverInbound(inbound_socket &s, bool closed);
     void notifySMS();
+    bool querySMS(int &count);
+    void checkSMSPending();
     int read(int socket, void *buffer, int max_len, int timeout=10000);
     void close(int socket);
 
@@ -152,22 +481,106 @@ protected:
     char loc_lat[16];
     char loc_lon[16];
     bool sms_pending;
+    bool sms_check;                     //+HHSMSRX seen, +HSMS? due
+    state_sms sms_state;
+    modem_result sms_result;            //MODEM_BUSY while a step is in flight
+    int sms_count;                      //from +HSMS?, -1 when unreadable
+    uint32_t sms_start;
     void (*sms_callback)(const String &sender, const rtc_datetime_t &timestamp, const String &message);
     void (*inbound_callback)(int length);
+    void (*inbound_socket_callback)(int socket, const uint8_t *data, int length);
     void (*event_callback)(cloud_event e);
     void (*location_callback)(const rtc_datetime_t &timestamp, const String &lat, const String &lon, int altitude, int uncertainty);
     void (*charge_callback)(charge_status status);
+    void (*sent_callback)(bool success);
     uint8_t *inbound_buffer;
-    int inbound_length;
+    int inbound_length;                 //per part
+    int inbound_parts;
+    inbound_socket inbound[INBOUND_SOCKETS];
+    int inbound_reading;                //socket with a +HSOCKREAD in flight, -1 for none
+    int inbound_next;
     uint8_t message_buffer[MAX_MESSAGE_SIZE];
     uint32_t message_length;
-    char topics[MAX_TOPICS][MAX_TOPIC_SIZE+1];
+    char topic_pool[TOPIC_POOL_SIZE];
+    uint16_t topic_pool_length;
+    uint16_t topics[MAX_TOPICS];        //pool offsets, sticky topics first
     uint32_t num_topics;
+    uint32_t num_sticky;
+    uint16_t sent_topics[MAX_TOPICS];   //the set the system processor holds
+    int32_t sent_count;                 //-1 when unknown
+    int32_t topic_keep;                 //+HMRST=1 support, 0 until tried
+    bool topic_reuse;
     bool ready;
     state_modem modem_state;
+    uint32_t link_at;                   //next probe or +HCONNECT
+    uint32_t link_probes;               //failed since the last reset
+    uint32_t link_backoffs;             //resets or failed connects in a row
+    uint32_t link_jitter;
+    bool link_pending;                  //a step is in the modem queue
+    bool link_holo;                     //the next probe is +HOLO?
     bool message_attempted;
     int32_t protocol_version;
-    int inbound_pending;
+    int status_cache;                   //-1 when stale
+    uint32_t status_time;
+    char iccid[24];                     //identity, empty until read
+    char imsi[20];
+    char sys_version[16];
+    char net_operator[32];
+    uint32_t operator_time;
+    bool clock_sync;
+    bool clock_synced;
+    bool clock_pending;                 //+CCLK in the modem queue
+    uint32_t clock_interval;
+    uint32_t clock_next;                //RTC seconds, counts through deep sleep
+    uint32_t clock_base;                //network time the drift is measured from
+    int32_t clock_error;                //seconds gained since clock_base, offset aside
+    clock_sync_stats clock_stats;
+    uint32_t write_chunk_limit;
+    ATFields urc_fields;
+    ATFields response_fields;
+    URCTable urc_tables[MAX_URC_TABLES];
+    int num_urc_tables;
+    cloud_stats stats;
+    MessageQueue outbox;
+    uint8_t send_chunk[HMWRITE_CHUNK_V2];
+    LZSS *compressor;
+    uint32_t outbox_retry;
+    uint32_t outbox_failures;
+    bool outbox_backoff;
+    bool windows;
+    bool window_open;
+    uint32_t window_period;
+    uint32_t window_max;
+    uint32_t window_early;
+    uint32_t window_left;               //still queued when the last window closed
+    uint32_t window_next;               //RTC seconds, counts through deep sleep
+    uint32_t window_start;
+    uint32_t window_sample;
+    uint16_t window_soc;                //gauge reading as the window opened
+    uint32_t window_removed;            //outbox deliveries before the window
+    tx_window_stats window_stats;
+    bool batching;
+    uint32_t batch_records;
+    bool batch_flushing;                //an aged batch is being sent async
+    uint32_t batch_start;
+    uint32_t batch_age;
+    uint32_t batch_size;
+    state_send send_state;
+    modem_result send_result;           //MODEM_BUSY while a step is in flight
+    bool send_kept;                     //+HMRST=1 tried for this send
+    bool send_ok;
+    bool send_success;
+    bool send_compressed;
+    bool send_streaming;
+    bool send_queued;                   //the message is the oldest outbox record
+    bool send_blocking;                 //sendMessage is waiting, write the buffer in one go
+    uint32_t send_seq;
+    uint32_t send_topics_length;
+    uint32_t send_index;                //next topic, a byte offset for queued ones
+    uint32_t send_position;             //payload sent, or chunk fill when streaming
+    uint32_t send_write_length;         //the +HMWRITE in flight, 0 when none
+    uint32_t send_size;
+    uint32_t send_start;
 };
 
 extern ArduinoModem modem;
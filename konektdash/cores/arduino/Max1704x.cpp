@@ -40,6 +40,12 @@ uint32_t Max1704x::mv()
 }
 
 uint8_t Max1704x::percentage()
+{
+    return soc() >> 8;
+}
+
+//1/256% per bit
+uint16_t Max1704x::soc()
 {
     wire->beginTransmission(ADDRESS);
     wire->write(0x04);
@@ -47,8 +53,8 @@ uint8_t Max1704x::percentage()
     wire->requestFrom(ADDRESS, (uint8_t)2);
     wire->endTransmission();
     while(wire->available() < 2);
-    uint8_t r = wire->read();
-    wire->read();
+    uint16_t r = wire->read() << 8;
+    r |= wire->read();
     return r;
 }
 
@@ -10,6 +10,7 @@ public:
     void quickStart();
     uint32_t mv();
     uint8_t percentage();
+    uint16_t soc(); //state of charge in 1/256%
     uint16_t version();
     uint16_t config();
     void setConfig(uint16_t config_value);
@@ -0,0 +1,359 @@
+/*
+  MessageQueue.cpp - Persistent FIFO of outbound messages and their topics kept
+  in a region of Flash. Survives resets, overwrites the oldest sector when full.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "MessageQueue.h"
+#include <string.h>
+#include <stddef.h>
+
+#define HEADER_WRITE offsetof(record_header, done)
+
+MessageQueue::MessageQueue()
+:flash(NULL), base(0), size(0), sector_size(0), head(0), tail(0), seq(0), write_offset(0), stage_length(0) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool MessageQueue::begin(Flash &f, uint32_t address, uint32_t region_size) {
+    end();
+    uint32_t sector = f.getSectorSize();
+    if(!f.ready() || address % sector != 0 || region_size < 2*sector) return false;
+
+    flash = &f;
+    base = address;
+    sector_size = sector;
+    size = region_size - (region_size % sector);
+    head = tail = 0;
+    memset(&stats, 0, sizeof(stats));
+
+    //rebuild the queue from what survived the reset: the newest record
+    //gives the write position, the oldest pending one the read position
+    bool found = false;
+    uint32_t newest = 0;
+    uint32_t oldest = 0;
+    record_header h;
+    for(uint32_t s=0; s<size; s+=sector_size) {
+        uint32_t offset = s;
+        while(offset + sizeof(h) <= s + sector_size && readHeader(offset, h)) {
+            if(h.seq != 0xFFFFFFFF) {
+                if(!found || (int32_t)(h.seq - newest) > 0) {
+                    newest = h.seq;
+                    tail = offset + recordSize(h);
+                    found = true;
+                }
+                if(pending(h)) {
+                    if(!intact(offset, h)) {
+                        markDone(offset);
+                        stats.dropped++;
+                    } else {
+                        if(stats.queued == 0 || (int32_t)(h.seq - oldest) < 0) {
+                            oldest = h.seq;
+                            head = offset;
+                        }
+                        stats.queued++;
+                    }
+                }
+            }
+            offset += recordSize(h);
+        }
+    }
+
+    seq = found ? newest + 1 : 0;
+    if(tail == size) tail = 0;
+    if(tail % sector_size != 0) {
+        //a torn header past the last record leaves the rest of the sector unusable
+        if(tail % sector_size + sizeof(h) > sector_size || !erased(tail, sizeof(h)))
+            tail = nextSector(tail);
+    }
+    if(stats.queued == 0) head = tail;
+    if(tail % sector_size == 0) reclaim(tail);
+    stats.high_water = stats.queued;
+    return true;
+}
+
+void MessageQueue::end() {
+    flash = NULL;
+}
+
+uint32_t MessageQueue::maxRecord() {
+    return ready() ? sector_size - sizeof(record_header) : 0;
+}
+
+bool MessageQueue::push(const char* const *topics, uint32_t num_topics, const uint8_t *data, uint32_t length) {
+    if(!ready()) return false;
+
+    uint32_t topics_length = 0;
+    for(uint32_t i=0; i<num_topics; i++) {
+        topics_length += strlen(topics[i]) + 1;
+    }
+    if(topics_length + length > maxRecord()) {
+        stats.rejected++;
+        return false;
+    }
+
+    record_header h;
+    h.magic = MESSAGE_QUEUE_MAGIC;
+    h.topics_length = topics_length;
+    h.length = length;
+    h.crc = 0xFFFF;
+    for(uint32_t i=0; i<num_topics; i++) {
+        h.crc = crc16(h.crc, (const uint8_t*)topics[i], strlen(topics[i]) + 1);
+    }
+    h.crc = crc16(h.crc, data, length);
+    h.seq = seq;
+    h.reserved = 0;
+    memset(h.done, 0xFF, sizeof(h.done));
+
+    uint32_t record = recordSize(h);
+    if(tail % sector_size + record > sector_size)
+        tail = nextSector(tail);
+    if(tail % sector_size == 0 && !reclaim(tail)) {
+        stats.rejected++;
+        return false;
+    }
+    if(stats.queued == 0) head = tail;
+
+    //header first, so a record torn by a reset still has a length to skip by
+    uint32_t start = tail;
+    write_offset = tail;
+    stage_length = 0;
+    bool ok = append(&h, HEADER_WRITE) && flushStage();
+    write_offset += sizeof(h.done);
+    for(uint32_t i=0; ok && i<num_topics; i++) {
+        ok = append(topics[i], strlen(topics[i]) + 1);
+    }
+    ok = ok && append(data, length) && flushStage();
+
+    //keep the sector ahead of tail erased so head never sits on tail
+    tail += record;
+    if(tail == size) tail = 0;
+    if(tail % sector_size + sizeof(h) > sector_size)
+        tail = nextSector(tail);
+    if(tail % sector_size == 0) reclaim(tail);
+    seq++;
+    if(!ok) {
+        markDone(start);
+        stats.rejected++;
+        return false;
+    }
+
+    stats.queued++;
+    stats.enqueued++;
+    if(stats.queued > stats.high_water) stats.high_water = stats.queued;
+    return true;
+}
+
+//length of the oldest record, topics included, retiring any that fail their crc
+int32_t MessageQueue::peek(uint32_t *topics_length) {
+    record_header h;
+    while(ready() && stats.queued > 0) {
+        if(readHeader(head, h) && pending(h)) {
+            if(intact(head, h)) {
+                if(topics_length) *topics_length = h.topics_length;
+                return h.topics_length + h.length;
+            }
+            markDone(head);
+        }
+        stats.queued--;
+        stats.dropped++;
+        advance();
+    }
+    return -1;
+}
+
+//copy from the body of the oldest record, topics first then payload
+uint32_t MessageQueue::read(uint32_t position, void *buffer, uint32_t count) {
+    record_header h;
+    if(!ready() || stats.queued == 0 || !readHeader(head, h)) return 0;
+    uint32_t length = h.topics_length + h.length;
+    if(position >= length) return 0;
+    if(count > length - position) count = length - position;
+    return flash->read(base + head + sizeof(h) + position, (uint8_t*)buffer, count);
+}
+
+bool MessageQueue::pop(bool delivered) {
+    if(!ready() || stats.queued == 0) return false;
+    markDone(head);
+    stats.queued--;
+    if(delivered)
+        stats.removed++;
+    else
+        stats.dropped++;
+    advance();
+    return true;
+}
+
+//changes once the oldest record is popped or overwritten
+uint32_t MessageQueue::headSeq() {
+    record_header h;
+    if(!ready() || stats.queued == 0 || !readHeader(head, h)) return 0xFFFFFFFF;
+    return h.seq;
+}
+
+bool MessageQueue::clear() {
+    if(!ready()) return false;
+    bool ok = true;
+    for(uint32_t s=0; s<size; s+=sector_size) {
+        if(!erased(s, sector_size))
+            ok = flash->eraseSector(base + s) && ok;
+    }
+    stats.dropped += stats.queued;
+    stats.queued = 0;
+    head = tail = 0;
+    return ok;
+}
+
+bool MessageQueue::readHeader(uint32_t offset, record_header &h) {
+    if(flash->read(base + offset, (uint8_t*)&h, sizeof(h)) != sizeof(h)) return false;
+    if(h.magic != MESSAGE_QUEUE_MAGIC) return false;
+    return sizeof(h) + h.topics_length + h.length <= sector_size - (offset % sector_size);
+}
+
+bool MessageQueue::intact(uint32_t offset, const record_header &h) {
+    uint8_t buffer[32];
+    uint16_t crc = 0xFFFF;
+    uint32_t address = base + offset + sizeof(h);
+    uint32_t remaining = h.topics_length + h.length;
+    while(remaining > 0) {
+        uint32_t n = remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+        if(flash->read(address, buffer, n) != n) return false;
+        crc = crc16(crc, buffer, n);
+        address += n;
+        remaining -= n;
+    }
+    return crc == h.crc;
+}
+
+uint32_t MessageQueue::recordSize(const record_header &h) {
+    uint32_t n = sizeof(h) + h.topics_length + h.length;
+    return (n + MESSAGE_QUEUE_ALIGN - 1) & ~(MESSAGE_QUEUE_ALIGN - 1);
+}
+
+uint32_t MessageQueue::nextSector(uint32_t offset) {
+    uint32_t n = sectorOf(offset) + sector_size;
+    return n >= size ? 0 : n;
+}
+
+uint32_t MessageQueue::next(uint32_t offset) {
+    record_header h;
+    if(readHeader(offset, h)) {
+        uint32_t n = offset + recordSize(h);
+        if(n % sector_size != 0 && n % sector_size + sizeof(h) <= sector_size)
+            return n;
+    }
+    return nextSector(offset);
+}
+
+bool MessageQueue::erased(uint32_t offset, uint32_t count) {
+    uint8_t buffer[32];
+    while(count > 0) {
+        uint32_t n = count < sizeof(buffer) ? count : sizeof(buffer);
+        if(flash->read(base + offset, buffer, n) != n) return false;
+        for(uint32_t i=0; i<n; i++) {
+            if(buffer[i] != 0xFF) return false;
+        }
+        offset += n;
+        count -= n;
+    }
+    return true;
+}
+
+//move head forward to the next pending record, stopping at tail
+void MessageQueue::advance() {
+    record_header h;
+    uint32_t limit = size / sizeof(h);
+    while(head != tail && limit--) {
+        uint32_t n = next(head);
+        if(sectorOf(head) == sectorOf(tail) && head < tail && (n > tail || n <= head))
+            n = tail;
+        head = n;
+        if(head != tail && readHeader(head, h) && pending(h))
+            return;
+    }
+    head = tail;
+    stats.queued = 0;
+}
+
+//make a sector writable again, dropping whatever was still pending in it
+bool MessageQueue::reclaim(uint32_t sector) {
+    if(erased(sector, sector_size)) return true;
+
+    record_header h;
+    uint32_t offset = sector;
+    while(offset + sizeof(h) <= sector + sector_size && readHeader(offset, h)) {
+        if(pending(h) && stats.queued > 0) {
+            stats.queued--;
+            stats.dropped++;
+        }
+        offset += recordSize(h);
+    }
+    bool head_here = sectorOf(head) == sector;
+    if(!flash->eraseSector(base + sector)) return false;
+
+    if(stats.queued == 0) {
+        head = tail;
+    } else if(head_here) {
+        head = nextSector(sector);
+        if(!(readHeader(head, h) && pending(h)))
+            advance();
+    }
+    return true;
+}
+
+bool MessageQueue::markDone(uint32_t offset) {
+    uint8_t done[MESSAGE_QUEUE_ALIGN];
+    memset(done, 0, sizeof(done));
+    return flash->write(base + offset + HEADER_WRITE, done, sizeof(done)) == sizeof(done);
+}
+
+bool MessageQueue::append(const void *data, uint32_t length) {
+    const uint8_t *p = (const uint8_t*)data;
+    while(length > 0) {
+        uint32_t n = MESSAGE_QUEUE_STAGE - stage_length;
+        if(n > length) n = length;
+        memcpy(&stage[stage_length], p, n);
+        stage_length += n;
+        p += n;
+        length -= n;
+        if(stage_length == MESSAGE_QUEUE_STAGE && !flushStage()) return false;
+    }
+    return true;
+}
+
+bool MessageQueue::flushStage() {
+    if(stage_length == 0) return true;
+    uint32_t n = (stage_length + MESSAGE_QUEUE_ALIGN - 1) & ~(MESSAGE_QUEUE_ALIGN - 1);
+    memset(&stage[stage_length], 0xFF, n - stage_length);
+    bool ok = flash->write(base + write_offset, stage, n) == n;
+    write_offset += n;
+    stage_length = 0;
+    return ok;
+}
+
+//CRC-16/CCITT
+uint16_t MessageQueue::crc16(uint16_t crc, const uint8_t *data, uint32_t length) {
+    while(length--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for(int i=0; i<8; i++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
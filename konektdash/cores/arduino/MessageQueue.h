@@ -0,0 +1,100 @@
+/*
+  MessageQueue.h - Persistent FIFO of outbound messages and their topics kept
+  in a region of Flash. Survives resets, overwrites the oldest sector when full.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "Flash.h"
+
+#define MESSAGE_QUEUE_MAGIC 0x4D51
+#define MESSAGE_QUEUE_STAGE 64
+#define MESSAGE_QUEUE_ALIGN 8   //flash program unit
+
+typedef struct {
+    uint32_t queued;            //records waiting in flash
+    uint32_t high_water;
+    uint32_t enqueued;
+    uint32_t removed;           //popped after delivery
+    uint32_t dropped;           //overwritten, corrupt or given up on
+    uint32_t rejected;          //too large or flash write failed
+}message_queue_stats;
+
+//Records are appended phrase aligned and never span a sector:
+//  [magic,topics_length,length,crc][seq,0][done][topics\0...][payload]
+//The done phrase is left erased and programmed once the record is
+//delivered, so no byte is ever written twice between erases.
+class MessageQueue {
+public:
+    MessageQueue();
+
+    bool begin(Flash &flash, uint32_t address, uint32_t size);
+    void end();
+    bool ready()                                {return flash != NULL;}
+
+    bool push(const char* const *topics, uint32_t num_topics, const uint8_t *data, uint32_t length);
+    int32_t peek(uint32_t *topics_length=NULL);
+    uint32_t read(uint32_t position, void *buffer, uint32_t count);
+    bool pop(bool delivered=true);
+    uint32_t headSeq();
+    bool clear();
+
+    uint32_t count()                            {return stats.queued;}
+    uint32_t maxRecord();
+    const message_queue_stats& getStats()       {return stats;}
+
+protected:
+    typedef struct {
+        uint16_t magic;
+        uint16_t topics_length;
+        uint16_t length;
+        uint16_t crc;
+        uint32_t seq;
+        uint32_t reserved;
+        uint8_t done[8];
+    }record_header;
+
+    bool readHeader(uint32_t offset, record_header &h);
+    bool intact(uint32_t offset, const record_header &h);
+    bool pending(const record_header &h)        {return h.seq != 0xFFFFFFFF && h.done[0] == 0xFF;}
+    uint32_t recordSize(const record_header &h);
+    uint32_t sectorOf(uint32_t offset)          {return offset - (offset % sector_size);}
+    uint32_t nextSector(uint32_t offset);
+    uint32_t next(uint32_t offset);
+    bool erased(uint32_t offset, uint32_t count);
+    void advance();
+    bool reclaim(uint32_t sector);
+    bool markDone(uint32_t offset);
+    bool append(const void *data, uint32_t length);
+    bool flushStage();
+    static uint16_t crc16(uint16_t crc, const uint8_t *data, uint32_t length);
+
+    Flash *flash;
+    uint32_t base;
+    uint32_t size;
+    uint32_t sector_size;
+    uint32_t head;              //oldest pending record
+    uint32_t tail;              //next write offset
+    uint32_t seq;
+    uint32_t write_offset;
+    uint8_t stage[MESSAGE_QUEUE_STAGE];
+    uint32_t stage_length;
+    message_queue_stats stats;
+};
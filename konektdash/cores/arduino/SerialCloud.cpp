@@ -44,19 +44,26 @@ void SerialCloudClass::end() {
 size_t SerialCloudClass::write(uint8_t x) {
     size_t s = HologramCloud.write(x);
     if(x == '\n') {
+        //with the outbox running, hand the line to flash instead of blocking
+        if(HologramCloud.isQueueReady() && HologramCloud.queueMessage()) {
+            store("+EVENT:MSGQUEUED\r\n");
+            HologramCloud.clear();
+            return s;
+        }
+        //pollEvents brings the link up and reads the URCs that update
+        //the cached status, delay() would leave both standing still
         while(!HologramCloud.isConnected()) {
-            delay(100);
+            HologramCloud.powerUp(100);
+            HologramCloud.pollEvents();
         }
-        bool success = false;
-        while(!success) {
-            success = HologramCloud.sendMessage();
-            if(success) {
-                store("+EVENT:MSGSENT\r\n");
-            } else {
-                delay(100);
+        while(!HologramCloud.sendMessage()) {
+            uint32_t start = millis();
+            while(millis() - start < 100) {
+                HologramCloud.pollEvents();
             }
         }
-        
+        store("+EVENT:MSGSENT\r\n");
+
         HologramCloud.clear();
     }
     return s;
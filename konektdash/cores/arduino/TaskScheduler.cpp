@@ -0,0 +1,194 @@
+/*
+  TaskScheduler.cpp - Cooperative run-to-completion scheduler for the main loop.
+  Periodic and triggered tasks run earliest deadline first, each timed
+  against its budget.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "TaskScheduler.h"
+#include "delay.h"
+#include <string.h>
+
+TaskScheduler::TaskScheduler()
+: num_tasks(0) {
+    memset(tasks, 0, sizeof(tasks));
+}
+
+int TaskScheduler::every(const char* name, uint32_t period_ms, task_function fn, void *context, uint32_t budget_us, uint32_t deadline_ms) {
+    return add(name, fn, context, period_ms, budget_us, deadline_ms ? deadline_ms : period_ms, false);
+}
+
+int TaskScheduler::onTrigger(const char* name, task_function fn, void *context, uint32_t budget_us, uint32_t deadline_ms) {
+    return add(name, fn, context, 0, budget_us, deadline_ms, true);
+}
+
+int TaskScheduler::add(const char* name, task_function fn, void *context, uint32_t period_ms, uint32_t budget_us, uint32_t deadline_ms, bool event) {
+    if(!name || !fn) return -1;
+    int id = 0;
+    while(id < num_tasks && tasks[id].name) id++;
+    if(id == MAX_TASKS) return -1;
+
+    task &t = tasks[id];
+    memset(&t, 0, sizeof(t));
+    t.fn = fn;
+    t.context = context;
+    t.period = period_ms;
+    t.deadline = deadline_ms;
+    t.budget = budget_us;
+    t.next = millis() + period_ms;
+    t.event = event;
+    t.enabled = true;
+    t.name = name;
+    if(id == num_tasks) num_tasks++;
+    return id;
+}
+
+bool TaskScheduler::trigger(int id) {
+    if(!valid(id) || !tasks[id].event) return false;
+    if(!tasks[id].triggered) {
+        tasks[id].trigger_ms = millis();
+        tasks[id].triggered = true;
+    }
+    return true;
+}
+
+bool TaskScheduler::remove(int id) {
+    if(!valid(id)) return false;
+    tasks[id].name = NULL;
+    tasks[id].ready = false;
+    while(num_tasks > 0 && !tasks[num_tasks-1].name) num_tasks--;
+    return true;
+}
+
+int TaskScheduler::find(const char* name) {
+    for(int i=0; i<num_tasks; i++) {
+        if(tasks[i].name && strcmp(tasks[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+bool TaskScheduler::setPeriod(int id, uint32_t period_ms) {
+    if(!valid(id) || tasks[id].event) return false;
+    if(tasks[id].deadline == tasks[id].period)
+        tasks[id].deadline = period_ms;
+    tasks[id].period = period_ms;
+    tasks[id].next = millis() + period_ms;
+    return true;
+}
+
+bool TaskScheduler::setBudget(int id, uint32_t budget_us, uint32_t deadline_ms) {
+    if(!valid(id)) return false;
+    tasks[id].budget = budget_us;
+    if(deadline_ms) tasks[id].deadline = deadline_ms;
+    return true;
+}
+
+bool TaskScheduler::enable(int id, bool enabled) {
+    if(!valid(id)) return false;
+    tasks[id].enabled = enabled;
+    if(!enabled) tasks[id].ready = false;
+    return true;
+}
+
+const char* TaskScheduler::name(int id) {
+    return valid(id) ? tasks[id].name : NULL;
+}
+
+const task_stats* TaskScheduler::getStats(int id) {
+    return valid(id) ? &tasks[id].stats : NULL;
+}
+
+void TaskScheduler::resetStats() {
+    for(int i=0; i<num_tasks; i++) {
+        memset(&tasks[i].stats, 0, sizeof(tasks[i].stats));
+    }
+}
+
+void TaskScheduler::run() {
+    uint32_t now = millis();
+    for(int i=0; i<num_tasks; i++) {
+        task &t = tasks[i];
+        t.done = false;
+        if(t.name && t.enabled && !t.event && t.period == 0) {
+            t.ready = true;
+            t.release = now;
+        }
+    }
+    //release again after every task, a long one may have made others due
+    int id;
+    do {
+        releaseDue(millis());
+        id = pick();
+        if(id >= 0) execute(tasks[id]);
+    }while(id >= 0);
+}
+
+void TaskScheduler::releaseDue(uint32_t now) {
+    for(int i=0; i<num_tasks; i++) {
+        task &t = tasks[i];
+        if(!t.name || !t.enabled || t.ready || t.done) continue;
+        if(t.event) {
+            if(t.triggered) {
+                t.triggered = false;
+                t.release = t.trigger_ms;
+                t.ready = true;
+            }
+        } else if(t.period && (int32_t)(now - t.next) >= 0) {
+            t.release = t.next;
+            t.next += t.period;
+            //fell more than a period behind, skip to the next release
+            if((int32_t)(now - t.next) >= 0) {
+                t.stats.misses += (now - t.next) / t.period + 1;
+                t.next = now + t.period;
+            }
+            t.ready = true;
+        }
+    }
+}
+
+//earliest deadline first, tasks without one keep their order after the rest
+int TaskScheduler::pick() {
+    int best = -1;
+    for(int i=0; i<num_tasks; i++) {
+        task &t = tasks[i];
+        if(!t.name || !t.ready) continue;
+        if(best < 0) {
+            best = i;
+            continue;
+        }
+        task &b = tasks[best];
+        if(t.deadline && (!b.deadline || (int32_t)((t.release + t.deadline) - (b.release + b.deadline)) < 0))
+            best = i;
+    }
+    return best;
+}
+
+void TaskScheduler::execute(task &t) {
+    t.ready = false;
+    t.done = true;
+    uint32_t start = micros();
+    t.fn(t.context);
+    uint32_t elapsed = micros() - start;
+
+    t.stats.runs++;
+    t.stats.total_us += elapsed;
+    if(elapsed > t.stats.max_us) t.stats.max_us = elapsed;
+    if(t.budget && elapsed > t.budget) t.stats.overruns++;
+    if(t.deadline && millis() - t.release > t.deadline) t.stats.misses++;
+}
@@ -0,0 +1,96 @@
+/*
+  TaskScheduler.h - Cooperative run-to-completion scheduler for the main loop.
+  Periodic and triggered tasks run earliest deadline first, each timed
+  against its budget.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef MAX_TASKS
+#define MAX_TASKS 12
+#endif
+
+typedef void (*task_function)(void *context);
+
+typedef struct {
+    uint32_t runs;
+    uint32_t total_us;
+    uint32_t max_us;
+    uint32_t overruns;          //ran longer than the budget
+    uint32_t misses;            //finished after the deadline or skipped a period
+}task_stats;
+
+//Tasks are never preempted. Each run() gives every released task at most
+//one turn, the one with the earliest deadline first. Tasks without a
+//deadline follow in the order they were added.
+class TaskScheduler {
+public:
+    TaskScheduler();
+
+    //period 0 runs the task on every pass, the deadline defaults to the period
+    int every(const char* name, uint32_t period_ms, task_function fn, void *context=NULL, uint32_t budget_us=0, uint32_t deadline_ms=0);
+    //runs once on the pass after trigger()
+    int onTrigger(const char* name, task_function fn, void *context=NULL, uint32_t budget_us=0, uint32_t deadline_ms=0);
+    bool trigger(int id);       //safe from an interrupt
+    bool remove(int id);
+    int find(const char* name);
+
+    bool setPeriod(int id, uint32_t period_ms);
+    bool setBudget(int id, uint32_t budget_us, uint32_t deadline_ms=0);
+    bool enable(int id, bool enabled);
+
+    void run();
+
+    int numTasks()                              {return num_tasks;}
+    const char* name(int id);
+    const task_stats* getStats(int id);
+    void resetStats();
+
+protected:
+    typedef struct {
+        const char* name;       //NULL when the slot is free
+        task_function fn;
+        void *context;
+        uint32_t period;
+        uint32_t deadline;
+        uint32_t budget;
+        uint32_t next;          //next release of a periodic task
+        uint32_t release;
+        bool event;
+        bool enabled;
+        bool ready;
+        bool done;              //had its turn this pass
+        volatile bool triggered;
+        volatile uint32_t trigger_ms;
+        task_stats stats;
+    }task;
+
+    int add(const char* name, task_function fn, void *context, uint32_t period_ms, uint32_t budget_us, uint32_t deadline_ms, bool event);
+    void releaseDue(uint32_t now);
+    int pick();
+    void execute(task &t);
+    bool valid(int id)                          {return id >= 0 && id < num_tasks && tasks[id].name;}
+
+    task tasks[MAX_TASKS];
+    int num_tasks;
+};
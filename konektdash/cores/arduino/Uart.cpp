@@ -188,3 +188,40 @@ size_t Uart::write(const uint8_t data)
 
     return 0;
 }
+
+size_t Uart::write(const uint8_t *buffer, size_t size)
+{
+#if FSL_FEATURE_SOC_UART_COUNT
+    if(!SIM_HAL_GetGateCmd(SIM, gate_name)) return 0;
+
+    if(singleWire) {
+        UART_HAL_SetTransmitterDir(instance, kUartSinglewireTxdirOut);
+    }
+
+    size_t n = 0;
+    uint32_t start = millis();
+    while(n < size) {
+        if(!UART_BRD_S1_TDRE(instance)) {
+            //same 10ms stall limit as write(uint8_t), counted since the last byte
+            if(millis() - start > 10)
+                break;
+            continue;
+        }
+        UART_HAL_Putchar(instance, buffer[n++]);
+        start = millis();
+    }
+
+    if(singleWire) {
+        start = millis();
+        while (!UART_BRD_S1_TC(instance))
+        {
+            if(millis() - start > 10)
+                break;
+        }
+        UART_HAL_SetTransmitterDir(instance, kUartSinglewireTxdirIn);
+    }
+    return n;
+#endif
+
+    return 0;
+}
@@ -44,6 +44,7 @@ public:
     void flush();
     void IrqHandler();
     size_t write(const uint8_t data);
+    size_t write(const uint8_t *buffer, size_t size);
     void end();
     int available();
     int peek();
@@ -135,6 +135,7 @@ DashCharger Charger(FuelGauge);
 Hologram HologramCloud;
 SerialCloudClass SerialCloud;
 MCUFlash DashFlash;
+TaskScheduler Tasks;
 
 #ifdef __cplusplus
 extern "C"
@@ -46,6 +46,7 @@
 #include "Hologram.h"
 #include "MCUFlash.h"
 #include "SerialCloud.h"
+#include "TaskScheduler.h"
 
 extern Uart Serial0;
 extern Uart SerialSystem;
@@ -58,6 +59,7 @@ extern DashCharger Charger;
 extern Hologram HologramCloud;
 extern MCUFlash DashFlash;
 extern SerialCloudClass SerialCloud;
+extern TaskScheduler Tasks;
 #define DashPro Dash
 
 #endif
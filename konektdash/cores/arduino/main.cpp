@@ -25,6 +25,11 @@
 void initVariant() __attribute__((weak));
 void initVariant() { }
 
+static void runLoop(void*) {loop();}
+static void runSerialEvent(void*) {if (serialEventRun) serialEventRun();}
+static void runCloud(void*) {HologramCloud.pollEvents();}
+static void runCharger(void*) {Charger.checkAuto();}
+
 /*
  * \brief Main entry point of Arduino application
  */
@@ -36,14 +41,18 @@ int main( void )
 
   delay(1);
 
+  // Registered before setup() so a sketch can find and retune them,
+  // tasks it adds are scheduled alongside
+  Tasks.every("loop", 0, runLoop);
+  Tasks.every("serial", 0, runSerialEvent);
+  Tasks.every("cloud", 0, runCloud);
+  Tasks.every("charger", 0, runCharger);
+
   setup();
 
   for (;;)
   {
-    loop();
-    if (serialEventRun) serialEventRun();
-    HologramCloud.pollEvents();
-    Charger.checkAuto();
+    Tasks.run();
   }
 
   return 0;
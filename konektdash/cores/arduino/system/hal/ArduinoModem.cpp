@@ -47,14 +47,28 @@ void ArduinoModem::modemout(uint8_t b) {
     if(debug) {
         switch(b) {
             case 0: debugout("\0"); break;
-            case 0x10: debugout("\\n"); break;
-            case 0x13: debugout("\\r"); break;
+            case '\n': debugout("\\n"); break;
+            case '\r': debugout("\\r"); break;
             default: debugout((char)b);
         }
     }
     uart->write(b);
 }
 
+void ArduinoModem::modemout(const uint8_t *data, uint32_t length) {
+    if(debug) {
+        for(uint32_t i=0; i<length; i++) {
+            switch(data[i]) {
+                case 0: debugout("\0"); break;
+                case '\n': debugout("\\n"); break;
+                case '\r': debugout("\\r"); break;
+                default: debugout((char)data[i]);
+            }
+        }
+    }
+    uart->write(data, length);
+}
+
 void ArduinoModem::debugout(const char* str) {
     if(debug) {
         debug->print(str);
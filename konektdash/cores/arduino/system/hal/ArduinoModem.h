@@ -34,6 +34,7 @@ protected:
     virtual void modemout(char c);
     virtual void modemout(const char* str);
     virtual void modemout(uint8_t b);
+    virtual void modemout(const uint8_t *data, uint32_t length);
     virtual void debugout(const char* str);
     virtual void debugout(char c);
     virtual void debugout(int i);
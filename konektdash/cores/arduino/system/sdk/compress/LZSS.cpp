@@ -0,0 +1,188 @@
+/*
+  LZSS.cpp - Streaming LZSS compressor with a fixed size match window, small
+  enough for the K22, and the matching decoder.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "LZSS.h"
+
+#include <cstring>
+
+#define LZSS_EMPTY 0xFFFF
+#define LZSS_LENGTH_BITS (16 - LZSS_WINDOW_BITS)
+
+LZSS::LZSS()
+: input(NULL), length(0), position(0), header_read(LZSS_HEADER_SIZE), group_length(0), group_read(0) {
+}
+
+bool LZSS::begin(const uint8_t *input, uint32_t length) {
+    if(length > LZSS_MAX_INPUT) return false;
+    this->input = input;
+    this->length = length;
+    position = 0;
+    header[0] = LZSS_MAGIC0;
+    header[1] = LZSS_MAGIC1;
+    header[2] = LZSS_WINDOW_BITS;
+    header[3] = length & 0xFF;
+    header[4] = length >> 8;
+    header_read = 0;
+    group_length = 0;
+    group_read = 0;
+    memset(head, 0xFF, sizeof(head));
+    return true;
+}
+
+//fill output with up to max compressed bytes, 0 once the stream is complete
+uint32_t LZSS::read(uint8_t *output, uint32_t max) {
+    uint32_t n = 0;
+    while(n < max && header_read < LZSS_HEADER_SIZE) {
+        output[n++] = header[header_read++];
+    }
+    while(n < max) {
+        if(group_read == group_length) {
+            if(position >= length) break;
+            encodeGroup();
+        }
+        uint32_t count = group_length - group_read;
+        if(count > max - n) count = max - n;
+        memcpy(&output[n], &group[group_read], count);
+        group_read += count;
+        n += count;
+    }
+    return n;
+}
+
+bool LZSS::done() {
+    return header_read == LZSS_HEADER_SIZE && group_read == group_length && position >= length;
+}
+
+//compressed size of the whole input, leaves the stream rewound
+uint32_t LZSS::measure() {
+    const uint8_t *data = input;
+    uint32_t size = length;
+    if(!begin(data, size)) return 0;
+    uint32_t total = LZSS_HEADER_SIZE;
+    while(position < length) {
+        encodeGroup();
+        total += group_length;
+    }
+    begin(data, size);
+    return total;
+}
+
+void LZSS::encodeGroup() {
+    group[0] = 0;
+    group_length = 1;
+    group_read = 0;
+    for(int bit=0; bit<8 && position < length; bit++) {
+        uint32_t offset = 0;
+        uint32_t n = match(&offset);
+        if(n >= LZSS_MIN_MATCH) {
+            uint16_t word = ((offset - 1) << LZSS_LENGTH_BITS) | (n - LZSS_MIN_MATCH);
+            group[group_length++] = word >> 8;
+            group[group_length++] = word & 0xFF;
+            while(n--) {
+                insert(position++);
+            }
+        } else {
+            group[0] |= 1 << bit;
+            group[group_length++] = input[position];
+            insert(position++);
+        }
+    }
+}
+
+//longest earlier match for the bytes at position, walking the hash chain
+uint32_t LZSS::match(uint32_t *offset) {
+    if(position + LZSS_MIN_MATCH > length) return 0;
+    uint32_t limit = length - position;
+    if(limit > LZSS_MAX_MATCH) limit = LZSS_MAX_MATCH;
+
+    const uint8_t *p = &input[position];
+    uint32_t best = 0;
+    uint32_t candidate = head[hash(p)];
+    for(int depth=0; depth<LZSS_CHAIN && candidate != LZSS_EMPTY; depth++) {
+        if(position - candidate > LZSS_WINDOW) break;
+        const uint8_t *c = &input[candidate];
+        if(c[best] == p[best] && c[0] == p[0]) {
+            uint32_t n = 1;
+            while(n < limit && c[n] == p[n]) n++;
+            if(n > best) {
+                best = n;
+                *offset = position - candidate;
+                if(best == limit) break;
+            }
+        }
+        uint32_t next = prev[candidate & (LZSS_WINDOW - 1)];
+        if(next >= candidate) break;
+        candidate = next;
+    }
+    return best;
+}
+
+void LZSS::insert(uint32_t at) {
+    if(at + LZSS_MIN_MATCH > length) return;
+    uint32_t h = hash(&input[at]);
+    prev[at & (LZSS_WINDOW - 1)] = head[h];
+    head[h] = at;
+}
+
+uint32_t LZSS::hash(const uint8_t *p) {
+    uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v * 2654435761U) >> (32 - LZSS_HASH_BITS);
+}
+
+bool LZSS::isCompressed(const uint8_t *data, uint32_t length) {
+    return length >= LZSS_HEADER_SIZE && data[0] == LZSS_MAGIC0 && data[1] == LZSS_MAGIC1;
+}
+
+//returns the decompressed length, or -1 for a corrupt stream or small output
+int32_t LZSS::decompress(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t max) {
+    if(!isCompressed(input, length)) return -1;
+    uint32_t window_bits = input[2];
+    if(window_bits < 1 || window_bits > 15) return -1;
+    uint32_t length_bits = 16 - window_bits;
+    uint32_t size = input[3] | (input[4] << 8);
+    if(size > max) return -1;
+
+    uint32_t i = LZSS_HEADER_SIZE;
+    uint32_t o = 0;
+    while(o < size) {
+        if(i >= length) return -1;
+        uint8_t flags = input[i++];
+        for(int bit=0; bit<8 && o < size; bit++) {
+            if(flags & (1 << bit)) {
+                if(i >= length) return -1;
+                output[o++] = input[i++];
+            } else {
+                if(i + 2 > length) return -1;
+                uint32_t word = (input[i] << 8) | input[i+1];
+                i += 2;
+                uint32_t offset = (word >> length_bits) + 1;
+                uint32_t n = (word & ((1 << length_bits) - 1)) + LZSS_MIN_MATCH;
+                if(offset > o || o + n > size) return -1;
+                while(n--) {
+                    output[o] = output[o - offset];
+                    o++;
+                }
+            }
+        }
+    }
+    return size;
+}
@@ -0,0 +1,82 @@
+/*
+  LZSS.h - Streaming LZSS compressor with a fixed size match window, small
+  enough for the K22, and the matching decoder.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+//offset bits of a match, the rest of its 16 bits hold the length
+#ifndef LZSS_WINDOW_BITS
+#define LZSS_WINDOW_BITS 10
+#endif
+#ifndef LZSS_HASH_BITS
+#define LZSS_HASH_BITS 9
+#endif
+//earlier positions tried per match search
+#ifndef LZSS_CHAIN
+#define LZSS_CHAIN 16
+#endif
+
+#define LZSS_WINDOW (1 << LZSS_WINDOW_BITS)
+#define LZSS_MIN_MATCH 3
+#define LZSS_MAX_MATCH (LZSS_MIN_MATCH + (1 << (16 - LZSS_WINDOW_BITS)) - 1)
+#define LZSS_MAX_INPUT 0xFFFE
+
+//Stream layout:
+//  0x1F 0x9E window_bits length_lo length_hi
+//then groups of a flag byte and up to 8 items, flag bit i (LSB first) set
+//for a literal byte, clear for a big endian match word of
+//(offset-1) << (16-window_bits) | (length-3)
+#define LZSS_MAGIC0 0x1F
+#define LZSS_MAGIC1 0x9E
+#define LZSS_HEADER_SIZE 5
+
+class LZSS {
+public:
+    LZSS();
+
+    bool begin(const uint8_t *input, uint32_t length);
+    uint32_t read(uint8_t *output, uint32_t max);
+    bool done();
+    uint32_t measure();
+
+    static bool isCompressed(const uint8_t *data, uint32_t length);
+    static int32_t decompress(const uint8_t *input, uint32_t length, uint8_t *output, uint32_t max);
+
+protected:
+    void encodeGroup();
+    uint32_t match(uint32_t *offset);
+    void insert(uint32_t at);
+    static uint32_t hash(const uint8_t *p);
+
+    const uint8_t *input;
+    uint32_t length;
+    uint32_t position;
+    uint8_t header[LZSS_HEADER_SIZE];
+    uint32_t header_read;
+    uint8_t group[1 + 8*2];
+    uint32_t group_length;
+    uint32_t group_read;
+    uint16_t head[1 << LZSS_HASH_BITS];
+    uint16_t prev[LZSS_WINDOW];
+};
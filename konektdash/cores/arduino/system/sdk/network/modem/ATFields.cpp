@@ -0,0 +1,167 @@
+/*
+  ATFields.cpp - Splits an AT response or URC line into its fields.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "ATFields.h"
+
+#include <cstring>
+
+ATFields::ATFields()
+: fields_prefix(""), quoted(0), num_fields(0) {
+    buffer[0] = 0;
+}
+
+bool ATFields::parse(const char* line) {
+    num_fields = 0;
+    quoted = 0;
+    fields_prefix = "";
+
+    size_t len = strlen(line);
+    if(len >= AT_FIELDS_SIZE) return false;
+    memcpy(buffer, line, len+1);
+
+    //"+NAME: a,"b,c",d" -> prefix "+NAME", fields a / b,c / d
+    char *p = strchr(buffer, ':');
+    if(p == NULL) {
+        fields_prefix = buffer;
+        return true;
+    }
+    *p++ = 0;
+    fields_prefix = buffer;
+    while(*p == ' ') p++;
+    if(*p == 0) return true;
+
+    while(num_fields < AT_MAX_FIELDS) {
+        if(*p == '"') {
+            quoted |= (1 << num_fields);
+            fields[num_fields++] = ++p;
+            p = strchr(p, '"');
+            if(p == NULL) return false;
+            *p++ = 0;
+        } else {
+            fields[num_fields++] = p;
+        }
+        p = strchr(p, ',');
+        if(p == NULL) break;
+        *p++ = 0;
+    }
+    return true;
+}
+
+bool ATFields::is(const char* prefix) const {
+    return strcmp(fields_prefix, prefix) == 0;
+}
+
+const char* ATFields::str(int i) const {
+    if(i < 0 || i >= num_fields) return "";
+    return fields[i];
+}
+
+size_t ATFields::copy(int i, char *dest, size_t size) const {
+    if(size == 0) return 0;
+    const char* s = str(i);
+    size_t len = strlen(s);
+    if(len >= size) len = size-1;
+    memcpy(dest, s, len);
+    dest[len] = 0;
+    return len;
+}
+
+const char* ATFields::decimal(const char* s, int32_t &value) {
+    //optional sign then digits, returns NULL if there are no digits
+    bool negative = false;
+    if(*s == '-' || *s == '+') {
+        negative = (*s == '-');
+        s++;
+    }
+    if(*s < '0' || *s > '9') return NULL;
+    uint32_t v = 0;
+    while(*s >= '0' && *s <= '9') {
+        v = v*10 + (*s++ - '0');
+    }
+    value = negative ? -(int32_t)v : (int32_t)v;
+    return s;
+}
+
+int32_t ATFields::toInt(int i, int32_t def) const {
+    if(i < 0 || i >= num_fields) return def;
+    const char* s = fields[i];
+    while(*s == ' ') s++;
+    int32_t v;
+    if(decimal(s, v) == NULL) return def;
+    return v;
+}
+
+uint32_t ATFields::toHex(int i, uint32_t def) const {
+    if(i < 0 || i >= num_fields) return def;
+    const char* s = fields[i];
+    while(*s == ' ') s++;
+    if(s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) s += 2;
+    uint32_t v = 0;
+    int digits = 0;
+    for(;; s++, digits++) {
+        char c = *s;
+        if(c >= '0' && c <= '9')        c -= '0';
+        else if(c >= 'A' && c <= 'F')   c -= 'A' - 10;
+        else if(c >= 'a' && c <= 'f')   c -= 'a' - 10;
+        else break;
+        v = (v << 4) | c;
+    }
+    return digits ? v : def;
+}
+
+int ATFields::toInts(int i, int32_t *values, int max) const {
+    //every number in the field, eg "17/06/01,12:00:00+00" -> 17 6 1 12 0 0 0
+    if(i < 0 || i >= num_fields) return 0;
+    const char* s = fields[i];
+    int n = 0;
+    while(*s && n < max) {
+        const char* end = decimal(s, values[n]);
+        if(end) {
+            s = end;
+            n++;
+        } else {
+            s++;
+        }
+    }
+    return n;
+}
+
+bool ATFields::toDate(int i, at_date &date) const {
+    //"yy/MM/dd,hh:mm:ss+zz", the timezone is optional
+    int32_t v[7];
+    int n = toInts(i, v, 7);
+    if(n < 6) return false;
+    if(v[1] < 1 || v[1] > 12 || v[2] < 1 || v[2] > 31) return false;
+    if(v[3] < 0 || v[3] > 23 || v[4] < 0 || v[4] > 59 || v[5] < 0 || v[5] > 60) return false;
+    date.year = v[0];
+    date.month = v[1];
+    date.day = v[2];
+    date.hour = v[3];
+    date.minute = v[4];
+    date.second = v[5];
+    date.tz = (n == 7) ? v[6] : 0;
+    return true;
+}
+
+bool ATFields::isQuoted(int i) const {
+    if(i < 0 || i >= num_fields) return false;
+    return (quoted & (1 << i)) != 0;
+}
@@ -0,0 +1,69 @@
+/*
+  ATFields.h - Splits an AT response or URC line into its fields.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#ifndef AT_MAX_FIELDS
+#define AT_MAX_FIELDS 12
+#endif
+
+#ifndef AT_FIELDS_SIZE
+#define AT_FIELDS_SIZE 160
+#endif
+
+typedef struct {
+    int16_t year;       //as sent, two digit years are not expanded
+    int8_t month;
+    int8_t day;
+    int8_t hour;
+    int8_t minute;
+    int8_t second;
+    int8_t tz;          //quarter hours from GMT, 0 when absent
+}at_date;
+
+class ATFields {
+public:
+    ATFields();
+    bool parse(const char* line);
+
+    const char* prefix() const {return fields_prefix;}
+    bool is(const char* prefix) const;
+    int count() const {return num_fields;}
+    const char* str(int i) const;
+    size_t copy(int i, char *dest, size_t size) const;
+    int32_t toInt(int i, int32_t def=0) const;
+    uint32_t toHex(int i, uint32_t def=0) const;
+    int toInts(int i, int32_t *values, int max) const;
+    bool toDate(int i, at_date &date) const;
+    bool isQuoted(int i) const;
+
+protected:
+    static const char* decimal(const char* s, int32_t &value);
+
+    char buffer[AT_FIELDS_SIZE];
+    const char* fields_prefix;
+    const char* fields[AT_MAX_FIELDS];
+    uint16_t quoted;
+    int num_fields;
+};
@@ -23,18 +23,114 @@
 
 #include <cstring>
 #include <cstdio>
+#include <cstdlib>
 
 void Modem::init(URCReceiver &receiver) {
     this->receiver = &receiver;
     async_state = MODEM_OK;
-    urc_read = 0;
-    urc_write = 0; 
+    queue_head = 0;
+    queue_count = 0;
+    servicing = false;
+    rxlength = 0;
+    timeout_count = 0;
+    num_stats = 0;
+    adaptive = true;
+    urcs.init(urc_buffer, sizeof(urc_buffer), URC_QUEUE_DEPTH);
+    urcs_priority.init(urc_priority_buffer, sizeof(urc_priority_buffer), URC_QUEUE_DEPTH);
 }
 
 uint32_t Modem::timeoutCount() {
     return timeout_count;
 }
 
+int Modem::numStats() {
+    return num_stats;
+}
+
+const modem_stats* Modem::getStats(int i) {
+    if(i < 0 || i >= num_stats) return NULL;
+    return &stats[i];
+}
+
+const modem_stats* Modem::getStats(const char* cmd) {
+    for(int i=0; i<num_stats; i++) {
+        if(strncmp(stats[i].cmd, cmd, sizeof(stats[i].cmd)-1) == 0)
+            return &stats[i];
+    }
+    return NULL;
+}
+
+void Modem::resetStats() {
+    num_stats = 0;
+}
+
+modem_stats* Modem::slot(const char* cmd) {
+    modem_stats *s = (modem_stats*)getStats(cmd);
+    if(s == NULL) {
+        //commands past the last slot are not tracked
+        if(num_stats == MODEM_STATS_SLOTS) return NULL;
+        s = &stats[num_stats++];
+        memset(s, 0, sizeof(modem_stats));
+        strncpy(s->cmd, cmd, sizeof(s->cmd)-1);
+        s->min_ms = 0xFFFFFFFF;
+    }
+    return s;
+}
+
+uint32_t Modem::adaptiveTimeout(const char* cmd, uint32_t timeout, uint32_t attempt) {
+    return attemptTimeout((modem_stats*)getStats(cmd), timeout, attempt);
+}
+
+uint32_t Modem::attemptTimeout(modem_stats *s, uint32_t timeout, uint32_t attempt) {
+    //RFC 6298 style: srtt + 4*rttvar, doubled for each retry, never more
+    //than the caller asked for. Until there are enough samples, or once
+    //the command has timed out MODEM_TIMEOUT_STREAK times in a row, the
+    //caller's timeout is used as is so short retries are not wasted.
+    if(!adaptive || s == NULL || s->samples < MODEM_ADAPT_SAMPLES ||
+            s->timeout_streak >= MODEM_TIMEOUT_STREAK)
+        return timeout;
+    uint32_t t = s->srtt_ms + 4*s->rttvar_ms;
+    if(t < MODEM_TIMEOUT_MIN) t = MODEM_TIMEOUT_MIN;
+    for(uint32_t i=0; i<attempt && t < timeout; i++) {
+        t *= 2;
+    }
+    return t < timeout ? t : timeout;
+}
+
+void Modem::sample(modem_stats *s, modem_result r, uint32_t elapsed, bool first) {
+    if(s == NULL) return;
+    if(r == MODEM_TIMEOUT) {
+        s->timeout_streak++;
+        return;
+    }
+    s->timeout_streak = 0;
+    //only unambiguous samples, a retried OK may answer an earlier attempt
+    if(r != MODEM_OK || !first) return;
+    if(s->samples == 0) {
+        s->srtt_ms = elapsed;
+        s->rttvar_ms = elapsed / 2;
+    } else {
+        uint32_t delta = elapsed > s->srtt_ms ? elapsed - s->srtt_ms : s->srtt_ms - elapsed;
+        s->rttvar_ms = (3*s->rttvar_ms + delta) / 4;
+        s->srtt_ms = (7*s->srtt_ms + elapsed) / 8;
+    }
+    s->samples++;
+}
+
+void Modem::record(const char* cmd, modem_result r, uint32_t startMillis, uint32_t retries) {
+    modem_stats *s = slot(cmd);
+    if(s == NULL) return;
+    uint32_t elapsed = msTick() - startMillis;
+    s->calls++;
+    s->retries += retries;
+    if(r == MODEM_OK) s->ok++;
+    else if(r == MODEM_TIMEOUT) s->timeouts++;
+    else s->errors++;
+    if(elapsed < s->min_ms) s->min_ms = elapsed;
+    if(elapsed > s->max_ms) s->max_ms = elapsed;
+    s->total_ms += elapsed;
+}
+
 const char* Modem::lastResponse() {
     return respbuffer;
 }
@@ -62,99 +158,302 @@ void Modem::appendSet(uint8_t *value, uint32_t len) {
 }
 
 modem_result Modem::intermediateSet(char expected, uint32_t timeout, uint32_t retries) {
-    checkURC();
-    if(async_state == MODEM_BUSY) return MODEM_BUSY;
+    if(!waitQueue()) return MODEM_BUSY;
+    modem_result r;
     do {
-        respbuffer[0] = 0;
-        modemwrite(cmdbuffer, CMD_STARTAT);
-        modemwrite("=");
-        modemwrite(valbuffer, CMD_END);
-        uint32_t startMillis = msTick();
-        while (msTick() - startMillis < timeout) {
-            while(modemavailable()) {
-                char c = modempeek();
-                debugout("<");
-                if(c == '\r') {
-                    debugout("\\r");
-                } else if(c == '\n') {
-                    debugout("\\n");
-                } else if(c < 0x21 || c > 0x7E)
-                    debugout((int)c);
-                else {
-                    debugout(c);
-                }
-                debugout(">\r\n");
-
-                if(c == expected) {
-                    modemread();
-                    return MODEM_OK;
-                } else if(c == '+') {
-                    if(modemavailable() >= 2)
-                        checkURC();
-                } else {
-                    modemread();
-                }
-            }
+        writeSet();
+        r = waitIntermediate(expected, timeout);
+    }while(r == MODEM_TIMEOUT && retries--);
+    return r;
+}
+
+void Modem::writeSet() {
+    //sends the set built by startSet/appendSet without waiting on a response
+    *valoffset = 0;
+    respbuffer[0] = 0;
+    modemwrite(cmdbuffer, CMD_STARTAT);
+    modemwrite("=");
+    modemwrite(valbuffer, CMD_END);
+    prompt_start = msTick();
+}
+
+modem_result Modem::waitIntermediate(char expected, uint32_t timeout) {
+    uint32_t startMillis = msTick();
+    while (msTick() - startMillis < timeout) {
+        int p = readPrompt(expected);
+        if(p > 0) {
+            set_start = prompt_start;
+            return MODEM_OK;
         }
-    }while(retries--);
+        if(p < 0) {
+            record(cmdbuffer, MODEM_ERROR, prompt_start);
+            return MODEM_ERROR;
+        }
+    }
     timeout_count++;
+    record(cmdbuffer, MODEM_TIMEOUT, prompt_start);
     return MODEM_TIMEOUT;
 }
 
+//takes what has arrived while a prompt is awaited, 1 once it came, -1 when
+//the command was refused instead, 0 while still waiting
+int Modem::readPrompt(char expected) {
+    while(modemavailable()) {
+        char c = modempeek();
+        debugout("<");
+        if(c == '\r') {
+            debugout("\\r");
+        } else if(c == '\n') {
+            debugout("\\n");
+        } else if(c < 0x21 || c > 0x7E)
+            debugout((int)c);
+        else {
+            debugout(c);
+        }
+        debugout(">\r\n");
+
+        if(c == expected && rxlength == 0) {
+            modemread();
+            return 1;
+        } else if(c == '+' || c == 'E' || rxlength > 0) {
+            if(readline(okbuffer)) {
+                //a refused set answers ERROR instead of the prompt
+                if(strcmp(okbuffer, "ERROR") == 0 || strncmp(okbuffer, "+CME ERROR:", 11) == 0) {
+                    strcpy(respbuffer, okbuffer);
+                    return -1;
+                }
+                if(okbuffer[0] == '+')
+                    pushURC(okbuffer);
+            }
+        } else {
+            modemread();
+        }
+    }
+    return 0;
+}
+
+modem_result Modem::writeChunked(const char* cmd, const uint8_t *data, uint32_t length, uint32_t chunk, uint32_t *written, bool pipeline, uint32_t timeout) {
+    //cmd=<n>, '@' prompt, n raw bytes, OK. Pipelined, the next cmd=<n> is
+    //sent before this chunk's OK so its prompt overlaps the completion.
+    *written = 0;
+    if(length == 0) return MODEM_OK;
+    uint32_t tosend = length < chunk ? length : chunk;
+    startSet(cmd);
+    appendSet((int)tosend);
+    modem_result r = intermediateSet('@', timeout);
+    while(r == MODEM_OK) {
+        dataWrite(&data[*written], tosend);
+        uint32_t remaining = length - *written - tosend;
+        uint32_t next = remaining < chunk ? remaining : chunk;
+        //not before the first chunk is confirmed, a refused first chunk
+        //leaves nothing else outstanding
+        bool pipelined = pipeline && next && *written > 0;
+        if(pipelined) {
+            startSet(cmd);
+            appendSet((int)next);
+            writeSet();
+        }
+        r = waitSetComplete(timeout);
+        if(r != MODEM_OK) {
+            if(pipelined && waitIntermediate('@', timeout) == MODEM_OK) {
+                //the next cmd is already out and its prompt can't be taken
+                //back, it gets the real chunk and the error still stands
+                dataWrite(&data[*written + tosend], next);
+                processResponse(timeout, cmd);
+            }
+            break;
+        }
+        *written += tosend;
+        if(next == 0) break;
+        if(pipelined) {
+            r = waitIntermediate('@', timeout);
+        } else {
+            startSet(cmd);
+            appendSet((int)next);
+            r = intermediateSet('@', timeout);
+        }
+        tosend = next;
+    }
+    return r;
+}
+
 modem_result Modem::waitSetComplete(uint32_t timeout, uint32_t retries)
 {
     return waitSetComplete(NULL, timeout, retries);
 }
 
 modem_result Modem::waitSetComplete(const char* expected, uint32_t timeout, uint32_t retries) {
+    //timed from the intermediateSet that started the command
     modem_result r = MODEM_TIMEOUT;
+    uint32_t attempts = 0;
     do {
+        attempts++;
         respbuffer[0] = 0;
         r = processResponse(timeout, cmdbuffer);
         if(r == MODEM_OK) {
-            if(expected) {
-                if(strcmp(expected, respbuffer) == 0) {
-                    return MODEM_OK;
-                } else {
-                    return MODEM_NO_MATCH;
-                }
-            } else {
-                return MODEM_OK;
+            if(expected && strcmp(expected, respbuffer) != 0) {
+                r = MODEM_NO_MATCH;
             }
+            break;
         }
     }while(retries--);
+    record(cmdbuffer, r, set_start, attempts-1);
     return r;
 }
 
 modem_result Modem::completeSet(uint32_t timeout, uint32_t retries) {
     *valoffset = 0;
-    set(cmdbuffer, valbuffer, timeout, retries);
+    return set(cmdbuffer, valbuffer, timeout, retries);
 }
 
 modem_result Modem::completeSet(const char* expected, uint32_t timeout, uint32_t retries) {
     *valoffset = 0;
-    set(cmdbuffer, valbuffer, expected, timeout, retries);
+    return set(cmdbuffer, valbuffer, expected, timeout, retries);
 }
 
-bool Modem::findline(char *buffer, uint32_t timeout, uint32_t startMillis) {
-    char *rx = buffer;
-    while (msTick() - startMillis < timeout) {
+modem_result Modem::completeSetPayload(uint8_t *buffer, int max_length, int *length, uint32_t timeout) {
+    *valoffset = 0;
+    *length = 0;
+    if(!waitQueue()) return MODEM_BUSY;
+    uint32_t startMillis = msTick();
+    modem_result r = readSetPayload(buffer, max_length, length, timeout, startMillis);
+    record(cmdbuffer, r, startMillis);
+    return r;
+}
+
+modem_result Modem::readSetPayload(uint8_t *buffer, int max_length, int *length, uint32_t timeout, uint32_t startMillis) {
+
+    respbuffer[0] = 0;
+    numresponses = 0;
+    modemwrite(cmdbuffer, CMD_STARTAT);
+    modemwrite("=");
+    modemwrite(valbuffer, CMD_END);
+
+    int cmdlen = strlen(cmdbuffer);
+    while(msTick() - startMillis < timeout) {
         while(modemavailable()) {
-            *rx = modemread();
-            if(*rx == '\n') {
-                while(*rx == '\n' || *rx == '\r') {
-                    *rx-- = 0;
+            char c = modemread();
+            if(c == '"' && rxlength > cmdlen+1) {
+                okbuffer[rxlength] = 0;
+                if(commandResponseMatch(cmdbuffer, okbuffer, cmdlen)) {
+                    //header is complete, the payload goes straight to the caller
+                    strcpy(respbuffer, okbuffer);
+                    rxlength = 0;
+                    if(!readPayload(buffer, max_length, length, timeout, startMillis)) {
+                        timeout_count++;
+                        return MODEM_TIMEOUT;
+                    }
+                    uint32_t elapsed = msTick() - startMillis;
+                    return processResponse(elapsed < timeout ? timeout - elapsed : 0, cmdbuffer);
                 }
-                debugout("{");
-                debugout(buffer);
-                debugout("}\r\n");
-                return true;
-            } else {
-                rx++;
             }
+            if(c == '\n') {
+                okbuffer[rxlength] = 0;
+                while(rxlength > 0 && okbuffer[rxlength-1] == '\r') {
+                    okbuffer[--rxlength] = 0;
+                }
+                rxlength = 0;
+                modem_result r = processLine(cmdbuffer, 0);
+                if(r == MODEM_OK && numresponses == 0) {
+                    return MODEM_NO_MATCH;
+                } else if(r != MODEM_BUSY) {
+                    return r;
+                }
+            } else if(rxlength < (int)sizeof(okbuffer)-1) {
+                okbuffer[rxlength++] = c;
+            }
+        }
+    }
+    rxlength = 0;
+    timeout_count++;
+    return MODEM_TIMEOUT;
+}
+
+int Modem::waitread(uint32_t timeout, uint32_t startMillis) {
+    while(!modemavailable()) {
+        if(msTick() - startMillis >= timeout) {
+            return -1;
+        }
+    }
+    return modemread();
+}
+
+bool Modem::readPayload(uint8_t *buffer, int max_length, int *length, uint32_t timeout, uint32_t startMillis) {
+    //header is "+CMD: ...,<hex>,<length>," with the payload quoted after it
+    int fields[2] = {0, 0};
+    const char* p = strchr(respbuffer, ':');
+    while(p) {
+        p++;
+        while(*p == ' ') p++;
+        if(*p == 0) break;
+        fields[0] = fields[1];
+        fields[1] = atoi(p);
+        p = strchr(p, ',');
+    }
+    bool hex = fields[0] == 1;
+    int count = fields[1];
+
+    int i = 0;
+    int high = -1;
+    while(i < count) {
+        if(!modemavailable()) {
+            if(msTick() - startMillis >= timeout) return false;
+            continue;
+        }
+        uint8_t b = modemread();
+        if(hex) {
+            if(high < 0) {
+                high = convertHex((char)b);
+                continue;
+            }
+            b = (high << 4) | convertHex((char)b);
+            high = -1;
+        }
+        if(i < max_length) {
+            buffer[i] = b;
+        }
+        i++;
+    }
+    *length = count < max_length ? count : max_length;
+
+    //discard the closing quote and the rest of the line
+    int c;
+    do {
+        c = waitread(timeout, startMillis);
+    }while(c >= 0 && c != '\n');
+    numresponses++;
+    return c >= 0;
+}
+
+bool Modem::readline(char *buffer) {
+    //partial lines are kept in buffer between calls
+    while(modemavailable()) {
+        char c = modemread();
+        if(c == '\n') {
+            char *rx = &buffer[rxlength];
+            *rx = 0;
+            while(rx > buffer && (rx[-1] == '\r' || rx[-1] == '\n')) {
+                *--rx = 0;
+            }
+            rxlength = 0;
+            debugout("{");
+            debugout(buffer);
+            debugout("}\r\n");
+            return true;
+        } else if(rxlength < (int)sizeof(okbuffer)-1) {
+            buffer[rxlength++] = c;
         }
     }
-    *rx = 0;
+    return false;
+}
+
+bool Modem::findline(char *buffer, uint32_t timeout, uint32_t startMillis) {
+    while (msTick() - startMillis < timeout) {
+        if(readline(buffer))
+            return true;
+    }
+    buffer[rxlength] = 0;
+    rxlength = 0;
     debugout("{");
     debugout(buffer);
     debugout("}!\r\n");
@@ -162,76 +461,52 @@ bool Modem::findline(char *buffer, uint32_t timeout, uint32_t startMillis) {
 }
 
 
-void Modem::pushURC(char c)
-{
-  int slot = nextSlotURC(urc_write);
-  if(slot != urc_read)
-  {
-    urc_buffer[urc_write] = c;
-    urc_write = slot;
-  }
-}
-
 void Modem::pushURC(const char* urc) {
-    int len = strlen(urc);
-    if(len+1 > remainingURC()) {
+    //raw bytes follow, they have to be read before the next line
+    if(isRawURC(urc)) {
+        dispatchURC(urc);
         return;
     }
-    
-    for(int i=0;i<len;i++) {
-        pushURC(urc[i]);
+    URCQueue &q = isPriorityURC(urc) ? urcs_priority : urcs;
+    if(&q == &urcs_priority) {
+        //newer connection state supersedes the oldest
+        while(!q.fits(urc) && q.dropOldest());
     }
-    pushURC('\n');
-}
-
-int Modem::popURC()
-{
-    if(urc_read == urc_write) {
-        return -1;
+    if(!q.push(urc)) {
+        debugout("!URC dropped: '");
+        debugout(urc);
+        debugout("'\r\n");
     }
+}
 
-    char c = urc_buffer[urc_read];
-    urc_read = nextSlotURC(urc_read);
+bool Modem::isPriorityURC(const char* urc) {
+    return strncmp(urc, "+HHCONNECTED:", 13) == 0 ||
+        strncmp(urc, "+HHREGISTERED:", 14) == 0 ||
+        strncmp(urc, "+HHOLO:", 7) == 0;
+}
 
-    return c;
+bool Modem::isRawURC(const char* urc) {
+    return strncmp(urc, "+HHSMSCTX:", 10) == 0;
 }
 
-int Modem::availableURC()
-{
-    int available = urc_write - urc_read;
+uint32_t Modem::urcDropCount() {
+    return urcs.dropped();
+}
 
-    if(available < 0) {
-        return URC_BUFFER_SIZE + available;
-    }
-    else {
-        return available;
-    }
+int Modem::urcHighWater() {
+    return urcs.highWater();
 }
 
-int Modem::remainingURC() {
-    return URC_BUFFER_SIZE - availableURC() - 1;
+uint32_t Modem::urcPriorityDropCount() {
+    return urcs_priority.dropped();
 }
 
-int Modem::nextSlotURC(int slot)
-{
-    return (uint32_t)(slot + 1) % URC_BUFFER_SIZE;
+int Modem::urcPriorityHighWater() {
+    return urcs_priority.highWater();
 }
 
-bool Modem::findlineURC(char *buffer) {
-    char *rx = buffer;
-    while(availableURC()) {
-        *rx = popURC();
-        if(*rx == '\n') {
-            while(*rx == '\n' || *rx == '\r') {
-                *rx-- = 0;
-            }
-            return true;
-        } else {
-            rx++;
-        }
-    }
-    *rx = 0;
-    return false;
+int Modem::urcQueued() {
+    return urcs.count() + urcs_priority.count();
 }
 
 void Modem::modemwrite(const char* cmd, cmd_flags flags) {
@@ -251,38 +526,30 @@ void Modem::modemwrite(const char* cmd, cmd_flags flags) {
     }
 }
 
-void Modem::checkURC() {
-    if(async_state == MODEM_BUSY) {
-        modem_result r = processResponse(10, cmdbuffer);
-        if(r == MODEM_TIMEOUT) {
-            if(msTick() - async_start >= async_timeout) {
-                async_state = MODEM_TIMEOUT;
-            }
-        } else {
-            async_state = r;
-        }
-        return;
+void Modem::dispatchURC(const char* urc) {
+    debugout("!URC: '");
+    debugout(urc);
+    debugout("'\r\n");
+    if(receiver) {
+        receiver->onURC(urc);
     }
+}
 
-    while(availableURC()) {
-        if(findlineURC(okbuffer)) {
-            if(receiver) {
-                receiver->onURC(okbuffer);
-            }
+void Modem::checkURC() {
+    processQueue();
+
+    //okbuffer may hold the start of a response still arriving
+    while(urcs_priority.pop(urc_line, sizeof(urc_line)) || urcs.pop(urc_line, sizeof(urc_line))) {
+        if(receiver) {
+            receiver->onURC(urc_line);
         }
     }
 
-    while(modemavailable()) {
-        uint32_t startMillis = msTick();
-        if(findline(okbuffer, 100, startMillis)) {
-            if(okbuffer[0] == '+') {
-                debugout("!URC: '");
-                debugout(okbuffer);
-                debugout("'\r\n");
-                if(receiver) {
-                    receiver->onURC(okbuffer);
-                }
-            }
+    if(busy()) return;
+
+    while(readline(okbuffer)) {
+        if(okbuffer[0] == '+') {
+            dispatchURC(okbuffer);
         }
     }
 }
@@ -316,24 +583,28 @@ uint32_t Modem::numResponses() {
     return numresponses;
 }
 
-modem_result Modem::processResponse(uint32_t timeout, const char* cmd, int minResponses) {
-    uint32_t startMillis = msTick();
-    numresponses = 0;
-    while(findline(okbuffer, timeout, startMillis)) {
-        if(okbuffer[0] == 0) {
-            continue;
-        } else if(strcmp(okbuffer, "ERROR") == 0) {
-            return MODEM_ERROR;
-        } else if(strncmp(okbuffer, "+CME ERROR:", 11) == 0) {
-            strcpy(respbuffer, okbuffer);
-            return MODEM_ERROR;
-        } else if(strncmp(okbuffer, "+CMS ERROR:", 11) == 0) {
-            strcpy(respbuffer, okbuffer);
-            return MODEM_ERROR;
-        } else if(strcmp(okbuffer, "OK") == 0 && numresponses >= minResponses) {
-            timeout_count = 0;
-            return MODEM_OK;
-        } else if(okbuffer[0] == '+') {
+modem_result Modem::processLine(const char* cmd, uint32_t minResponses) {
+    switch(okbuffer[0]) {
+        case 0:
+            return MODEM_BUSY;
+        case 'O':
+            if(okbuffer[1] == 'K' && okbuffer[2] == 0 && numresponses >= minResponses) {
+                timeout_count = 0;
+                return MODEM_OK;
+            }
+            break;
+        case 'E':
+            if(strcmp(okbuffer, "ERROR") == 0) {
+                return MODEM_ERROR;
+            }
+            break;
+        case '+':
+            //+CME ERROR: and +CMS ERROR:
+            if(okbuffer[1] == 'C' && okbuffer[2] == 'M' && (okbuffer[3] == 'E' || okbuffer[3] == 'S')
+                    && strncmp(&okbuffer[4], " ERROR:", 7) == 0) {
+                strcpy(respbuffer, okbuffer);
+                return MODEM_ERROR;
+            }
             timeout_count = 0;
             if(commandResponseMatch(cmd, okbuffer, strlen(cmd))) {
                 numresponses++;
@@ -344,39 +615,70 @@ modem_result Modem::processResponse(uint32_t timeout, const char* cmd, int minRe
                 debugout("'\r\n");
                 pushURC(okbuffer);
             }
+            return MODEM_BUSY;
+        case 'A':
+            if(okbuffer[1] == 'T' && strncmp(&okbuffer[2], cmd, strlen(cmd)) == 0) {
+                debugout(">ECHO: '");
+                debugout(okbuffer);
+                debugout("'\r\n");
+                return MODEM_BUSY;
+            }
+            break;
+    }
+    strcpy(respbuffer, okbuffer);
+    return MODEM_BUSY;
+}
+
+modem_result Modem::processResponse(uint32_t timeout, const char* cmd, uint32_t minResponses) {
+    uint32_t startMillis = msTick();
+    numresponses = 0;
+    while(findline(okbuffer, timeout, startMillis)) {
+        modem_result r = processLine(cmd, minResponses);
+        if(r != MODEM_BUSY) {
+            return r;
+        }
+        if(okbuffer[0] == '+') {
             startMillis = msTick();
-        } else if(strncmp(okbuffer, "AT", 2) == 0 && strncmp(&okbuffer[2], cmd, strlen(cmd)) == 0) {
-            debugout(">ECHO: '");
-            debugout(okbuffer);
-            debugout("'\r\n");
-        } else {
-            strcpy(respbuffer, okbuffer);
         }
     }
     timeout_count++;
     return MODEM_TIMEOUT;
 }
 
+//the reply to an attempt that timed out early may still be on its way.
+//Sent again right away, that reply would be taken for the new attempt's
+//and the new one's for whatever command comes next
+modem_result Modem::lateResponse(const char* cmd) {
+    modem_result r = processResponse(MODEM_LATE_MS, cmd);
+    if(r == MODEM_TIMEOUT) timeout_count--; //counted once for the attempt
+    return r;
+}
+
 modem_result Modem::command(const char* cmd, const char* expected, uint32_t timeout, uint32_t retries, bool query) {
-    checkURC();
-    if(async_state == MODEM_BUSY) return MODEM_BUSY;
+    if(!waitQueue()) return MODEM_BUSY;
     modem_result r = MODEM_TIMEOUT;
+    modem_stats *s = slot(cmd);
+    uint32_t startMillis = msTick();
+    uint32_t attempts = 0;
     do {
+        //the last attempt always gets the caller's full timeout
+        uint32_t t = retries ? attemptTimeout(s, timeout, attempts) : timeout;
+        uint32_t attemptMillis = msTick();
+        attempts++;
         respbuffer[0] = 0;
         modemwrite(cmd, query ? CMD_FULL_QUERY : CMD_FULL);
-        r = processResponse(timeout, cmd);
+        r = processResponse(t, cmd);
+        sample(s, r, msTick() - attemptMillis, attempts == 1);
+        if(r == MODEM_TIMEOUT && t < timeout)
+            r = lateResponse(cmd);
         if(r == MODEM_OK) {
-            if(expected) {
-                if(strcmp(expected, respbuffer) == 0) {
-                    return MODEM_OK;
-                } else {
-                    return MODEM_NO_MATCH;
-                }
-            } else {
-                return MODEM_OK;
+            if(expected && strcmp(expected, respbuffer) != 0) {
+                r = MODEM_NO_MATCH;
             }
+            break;
         }
     }while(retries--);
+    record(cmd, r, startMillis, attempts-1);
     return r;
 }
 
@@ -385,33 +687,173 @@ modem_result Modem::command(const char* cmd, uint32_t timeout, uint32_t retries,
 }
 
 modem_result Modem::asyncStatus() {
-    return async_state;
+    return busy() ? MODEM_BUSY : async_state;
 }
 
 modem_result Modem::asyncSet(const char* cmd, const char* value, uint32_t timeout) {
     checkURC();
-    if(async_state == MODEM_BUSY) return MODEM_BUSY;
-    respbuffer[0] = 0;
-    strcpy(cmdbuffer, cmd);
-    modemwrite(cmd, CMD_STARTAT);
-    modemwrite("=");
-    modemwrite(value, CMD_END);
-    async_state = MODEM_BUSY;
-    async_timeout = timeout;
-    async_start = msTick();
+    if(busy()) return MODEM_BUSY;
+    return submitSet(cmd, value, NULL, NULL, timeout);
+}
+
+int Modem::queuedCommands() {
+    return queue_count;
+}
+
+//blocking calls go after the submitted commands, each of which completes
+//or times out on its own. Commands their callbacks submit are not waited
+//for past the timeouts queued on entry, and a callback cannot wait on the
+//queue it is called from
+bool Modem::waitQueue() {
+    checkURC();
+    if(!busy()) return true;
+    if(servicing) return false;
+    uint32_t limit = 0;
+    for(int i=0; i<queue_count; i++) {
+        limit += queue[(queue_head + i) % MODEM_QUEUE_DEPTH].timeout;
+    }
+    uint32_t startMillis = msTick();
+    while(busy() && msTick() - startMillis < limit) {
+        checkURC();
+    }
+    return !busy();
+}
+
+modem_result Modem::submitCommand(const char* cmd, modem_callback callback, void* context, uint32_t timeout, const char* expected) {
+    return submit(cmd, NULL, CMD_FULL, callback, context, timeout, expected);
+}
+
+modem_result Modem::submitQuery(const char* cmd, modem_callback callback, void* context, uint32_t timeout, const char* expected) {
+    return submit(cmd, NULL, CMD_FULL_QUERY, callback, context, timeout, expected);
+}
+
+modem_result Modem::submitSet(const char* cmd, const char* value, modem_callback callback, void* context, uint32_t timeout, const char* expected) {
+    return submit(cmd, value, CMD_STARTAT, callback, context, timeout, expected);
+}
+
+modem_result Modem::submitWrite(const char* cmd, const uint8_t *data, uint32_t length, modem_callback callback, void* context, uint32_t timeout) {
+    char value[12];
+    sprintf(value, "%u", (unsigned int)length);
+    return submit(cmd, value, CMD_STARTAT, callback, context, timeout, NULL, data, length);
+}
+
+modem_result Modem::submit(const char* cmd, const char* value, uint8_t flags, modem_callback callback, void* context, uint32_t timeout, const char* expected, const uint8_t *data, uint32_t length) {
+    if(queue_count == MODEM_QUEUE_DEPTH) return MODEM_BUSY;
+
+    queued_command &q = queue[(queue_head + queue_count) % MODEM_QUEUE_DEPTH];
+    if(strlen(cmd) >= sizeof(q.cmd)) return MODEM_ERROR;
+    if(value && strlen(value) >= sizeof(q.value)) return MODEM_ERROR;
+    if(expected && strlen(expected) >= sizeof(q.expected)) return MODEM_ERROR;
+
+    strcpy(q.cmd, cmd);
+    strcpy(q.value, value ? value : "");
+    strcpy(q.expected, expected ? expected : "");
+    q.flags = flags;
+    q.sent = false;
+    q.timeout = timeout;
+    q.callback = callback;
+    q.context = context;
+    q.data = data;
+    q.length = length;
+    q.prompted = false;
+    queue_count++;
+
+    processQueue();
     return MODEM_OK;
 }
 
+void Modem::processQueue() {
+    if(servicing) return;
+    servicing = true;
+    while(queue_count) {
+        queued_command &q = queue[queue_head];
+        if(!q.sent) {
+            //flush URCs that arrived ahead of this command
+            while(readline(okbuffer)) {
+                if(okbuffer[0] == '+') {
+                    pushURC(okbuffer);
+                }
+            }
+            respbuffer[0] = 0;
+            numresponses = 0;
+            if(q.flags == CMD_STARTAT) {
+                modemwrite(q.cmd, CMD_STARTAT);
+                modemwrite("=");
+                modemwrite(q.value, CMD_END);
+            } else {
+                modemwrite(q.cmd, (cmd_flags)q.flags);
+            }
+            q.sent = true;
+            q.start = msTick();
+            q.sent_at = q.start;
+        }
+
+        modem_result r = MODEM_BUSY;
+        if(q.data && !q.prompted) {
+            //at most a chunk goes out per call, the transport may block on it
+            int p = readPrompt('@');
+            if(p > 0) {
+                dataWrite(q.data, q.length);
+                q.prompted = true;
+                q.start = msTick();
+            } else if(p < 0) {
+                r = MODEM_ERROR;
+            }
+        }
+        while(r == MODEM_BUSY && (!q.data || q.prompted) && readline(okbuffer)) {
+            r = processLine(q.cmd, 0);
+            if(okbuffer[0] == '+') {
+                q.start = msTick();
+            }
+        }
+        if(r == MODEM_BUSY) {
+            if(msTick() - q.start < q.timeout) break;
+            timeout_count++;
+            r = MODEM_TIMEOUT;
+        }
+        completeQueued(r);
+    }
+    servicing = false;
+}
+
+void Modem::completeQueued(modem_result r) {
+    queued_command &q = queue[queue_head];
+    if(r == MODEM_OK && q.expected[0]) {
+        if(strncmp(q.expected, respbuffer, strlen(q.expected)) != 0) {
+            r = MODEM_NO_MATCH;
+        }
+    }
+    sample(slot(q.cmd), r, msTick() - q.sent_at, true);
+    record(q.cmd, r, q.sent_at);
+    modem_callback callback = q.callback;
+    void *context = q.context;
+    queue_head = (queue_head + 1) % MODEM_QUEUE_DEPTH;
+    queue_count--;
+    async_state = r;
+    if(callback) {
+        callback(r, respbuffer, context);
+    }
+}
+
 modem_result Modem::set(const char* cmd, const char* value, const char* expected, uint32_t timeout, uint32_t retries) {
-    checkURC();
-    if(async_state == MODEM_BUSY) return MODEM_BUSY;
+    if(!waitQueue()) return MODEM_BUSY;
     modem_result r = MODEM_TIMEOUT;
+    modem_stats *s = slot(cmd);
+    uint32_t startMillis = msTick();
+    uint32_t attempts = 0;
     do {
+        //the last attempt always gets the caller's full timeout
+        uint32_t t = retries ? attemptTimeout(s, timeout, attempts) : timeout;
+        uint32_t attemptMillis = msTick();
+        attempts++;
         respbuffer[0] = 0;
         modemwrite(cmd, CMD_STARTAT);
         modemwrite("=");
         modemwrite(value, CMD_END);
-        r = processResponse(timeout, cmd);
+        r = processResponse(t, cmd);
+        sample(s, r, msTick() - attemptMillis, attempts == 1);
+        if(r == MODEM_TIMEOUT && t < timeout)
+            r = lateResponse(cmd);
         if(r == MODEM_OK) {
             if(expected) {
                 if(strcmp(expected, respbuffer) == 0) {
@@ -420,15 +862,14 @@ modem_result Modem::set(const char* cmd, const char* value, const char* expected
                     debugout("' '");
                     debugout(respbuffer);
                     debugout("'\r\n");
-                    return MODEM_OK;
                 } else {
-                    return MODEM_NO_MATCH;
+                    r = MODEM_NO_MATCH;
                 }
-            } else {
-                return MODEM_OK;
             }
+            break;
         }
     }while(retries--);
+    record(cmd, r, startMillis, attempts-1);
     return r;
 }
 
@@ -449,8 +890,13 @@ void Modem::dataWrite(uint8_t b) {
 }
 
 void Modem::dataWrite(const uint8_t* content, uint32_t length) {
+    modemout(content, length);
+}
+
+void Modem::modemout(const uint8_t *data, uint32_t length) {
+    //override to hand the whole span to the transport
     for(uint32_t i=0; i<length; i++)
-        modemout(content[i]);
+        modemout(data[i]);
 }
 
 void Modem::rawRead(int length, void* buffer) {
@@ -23,6 +23,7 @@
 
 #include <cstdint>
 #include <cstddef>
+#include "URCQueue.h"
 
 typedef enum {
     MODEM_BUSY = -4,
@@ -32,6 +33,65 @@ typedef enum {
     MODEM_OK = 0,
 }modem_result;
 
+typedef void (*modem_callback)(modem_result result, const char* response, void* context);
+
+#ifndef MODEM_QUEUE_DEPTH
+#define MODEM_QUEUE_DEPTH 4
+#endif
+
+#ifndef URC_BUFFER_SIZE
+#define URC_BUFFER_SIZE 256
+#endif
+
+#ifndef URC_QUEUE_DEPTH
+#define URC_QUEUE_DEPTH 16
+#endif
+
+//connection state URCs get their own queue so a burst of other URCs
+//cannot push them out, the oldest is dropped when it fills
+#ifndef URC_PRIORITY_SIZE
+#define URC_PRIORITY_SIZE 64
+#endif
+
+#ifndef MODEM_STATS_SLOTS
+#define MODEM_STATS_SLOTS 16
+#endif
+
+typedef struct {
+    char cmd[16];           //"+CSQ", "" for AT
+    uint32_t calls;
+    uint32_t ok;
+    uint32_t errors;        //ERROR, +CME/+CMS ERROR and expected response mismatches
+    uint32_t timeouts;
+    uint32_t retries;
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint32_t total_ms;
+    uint32_t srtt_ms;       //smoothed latency of first attempts that got OK
+    uint32_t rttvar_ms;
+    uint32_t samples;
+    uint32_t timeout_streak;
+}modem_stats;
+
+//adaptive timeouts, see Modem::attemptTimeout
+#ifndef MODEM_ADAPT_SAMPLES
+#define MODEM_ADAPT_SAMPLES 4
+#endif
+
+#ifndef MODEM_TIMEOUT_MIN
+#define MODEM_TIMEOUT_MIN 100
+#endif
+
+#ifndef MODEM_TIMEOUT_STREAK
+#define MODEM_TIMEOUT_STREAK 3
+#endif
+
+//how long a reply that missed a shortened timeout is waited for before
+//the command is sent again
+#ifndef MODEM_LATE_MS
+#define MODEM_LATE_MS 250
+#endif
+
 class URCReceiver {
 public:
     virtual void onURC(const char* urc)=0;
@@ -46,6 +106,13 @@ public:
     modem_result set(const char* cmd, const char* value, const char* expected, uint32_t timeout=1000, uint32_t retries=0);
     modem_result asyncSet(const char* cmd, const char* value, uint32_t timeout=1000);
     modem_result asyncStatus();
+    modem_result submitCommand(const char* cmd, modem_callback callback=NULL, void* context=NULL, uint32_t timeout=1000, const char* expected=NULL);
+    modem_result submitQuery(const char* cmd, modem_callback callback=NULL, void* context=NULL, uint32_t timeout=1000, const char* expected=NULL);
+    modem_result submitSet(const char* cmd, const char* value, modem_callback callback=NULL, void* context=NULL, uint32_t timeout=1000, const char* expected=NULL);
+    //cmd=<length>, then the data once the '@' prompt arrives. The data is
+    //written from a checkURC and must stay put until the callback
+    modem_result submitWrite(const char* cmd, const uint8_t *data, uint32_t length, modem_callback callback=NULL, void* context=NULL, uint32_t timeout=10000);
+    int queuedCommands();
     void startSet(const char* cmd);
     void appendSet(int value);
     void appendSet(const char* value);
@@ -53,7 +120,13 @@ public:
     void appendSet(uint8_t *value, uint32_t len);
     modem_result completeSet(uint32_t timeout=1000, uint32_t retries=0);
     modem_result completeSet(const char* expected, uint32_t timeout=1000, uint32_t retries=0);
+    modem_result completeSetPayload(uint8_t *buffer, int max_length, int *length, uint32_t timeout=1000);
     modem_result intermediateSet(char expected, uint32_t timeout=1000, uint32_t retries=0);
+    void writeSet();
+    modem_result waitIntermediate(char expected, uint32_t timeout=1000);
+    //written counts the chunks confirmed. After an error the data already
+    //accepted is of no use, reset it (+HMRST) before writing again
+    modem_result writeChunked(const char* cmd, const uint8_t *data, uint32_t length, uint32_t chunk, uint32_t *written, bool pipeline=true, uint32_t timeout=10000);
     modem_result waitSetComplete(uint32_t timeout=1000, uint32_t retries=0);
     modem_result waitSetComplete(const char* expected, uint32_t timeout=1000, uint32_t retries=0);
     modem_result query(const char* cmd, uint32_t timeout=1000, uint32_t retries=0) {
@@ -63,6 +136,18 @@ public:
         return command(cmd, expected, timeout, retries, true);
     }
     uint32_t timeoutCount();
+    int numStats();
+    const modem_stats* getStats(int i);
+    const modem_stats* getStats(const char* cmd);
+    void resetStats();
+    void setAdaptiveTimeouts(bool enable)   {adaptive = enable;}
+    uint32_t adaptiveTimeout(const char* cmd, uint32_t timeout, uint32_t attempt=0);
+    //per queue, connection state URCs have their own that drops the oldest
+    uint32_t urcDropCount();
+    int urcHighWater();
+    uint32_t urcPriorityDropCount();
+    int urcPriorityHighWater();
+    int urcQueued();
     const char* lastResponse();
     uint32_t numResponses();
     void checkURC();
@@ -77,7 +162,6 @@ public:
     static uint8_t convertHex(const char* hex);
 
 protected:
-    #define URC_BUFFER_SIZE 256
     typedef enum {
         CMD_NONE  = 0x00,
         CMD_START = 0x01,
@@ -93,6 +177,7 @@ protected:
     virtual void modemout(char c)=0;
     virtual void modemout(const char* str)=0;
     virtual void modemout(uint8_t b)=0;
+    virtual void modemout(const uint8_t *data, uint32_t length);
     virtual void debugout(const char* str){}
     virtual void debugout(char c){}
     virtual void debugout(int i){}
@@ -100,18 +185,47 @@ protected:
     virtual uint8_t modemread()=0;
     virtual uint8_t modempeek()=0;
     void modemwrite(const char* cmd, cmd_flags flags = CMD_NONE);
+    typedef struct {
+        char cmd[24];
+        char value[48];
+        char expected[24];
+        uint8_t flags;
+        bool sent;
+        uint32_t start;
+        uint32_t sent_at;
+        uint32_t timeout;
+        modem_callback callback;
+        void *context;
+        const uint8_t *data;    //written at the prompt, NULL for other commands
+        uint32_t length;
+        bool prompted;
+    }queued_command;
+
+    bool readline(char *buffer);
+    int waitread(uint32_t timeout, uint32_t startMillis);
+    modem_result readSetPayload(uint8_t *buffer, int max_length, int *length, uint32_t timeout, uint32_t startMillis);
+    bool readPayload(uint8_t *buffer, int max_length, int *length, uint32_t timeout, uint32_t startMillis);
     bool findline(char *buffer, uint32_t timeout, uint32_t startMillis);
-    modem_result processResponse(uint32_t timeout, const char* cmd, int minResponse=0);
+    modem_result processLine(const char* cmd, uint32_t minResponses);
+    modem_result processResponse(uint32_t timeout, const char* cmd, uint32_t minResponses=0);
+    modem_result lateResponse(const char* cmd);
+    modem_result submit(const char* cmd, const char* value, uint8_t flags, modem_callback callback, void* context, uint32_t timeout, const char* expected, const uint8_t *data=NULL, uint32_t length=0);
+    int readPrompt(char expected);
+    void processQueue();
+    bool waitQueue();
+    void completeQueued(modem_result r);
+    void dispatchURC(const char* urc);
+    void record(const char* cmd, modem_result r, uint32_t startMillis, uint32_t retries=0);
+    modem_stats* slot(const char* cmd);
+    uint32_t attemptTimeout(modem_stats *s, uint32_t timeout, uint32_t attempt);
+    void sample(modem_stats *s, modem_result r, uint32_t elapsed, bool first);
+    bool busy() {return queue_count > 0;}
     int strncmpci(const char* str1, const char* str2, size_t num);
     bool commandResponseMatch(const char* cmd, const char* response, int num);
 
-    void pushURC(char c);
     void pushURC(const char* urc);
-    int popURC();
-    int availableURC();
-    int remainingURC();
-    int nextSlotURC(int slot);
-    bool findlineURC(char *buffer);
+    bool isPriorityURC(const char* urc);
+    bool isRawURC(const char* urc);
 
     URCReceiver *receiver;
     char cmdbuffer[32];
@@ -120,11 +234,21 @@ protected:
     char okbuffer[512];
     char *valoffset;
     uint32_t numresponses;
+    int rxlength;
     modem_result async_state;
-    uint32_t async_start;
-    uint32_t async_timeout;
+    queued_command queue[MODEM_QUEUE_DEPTH];
+    int queue_head;
+    int queue_count;
+    bool servicing;
     uint32_t timeout_count;
+    uint32_t set_start;
+    uint32_t prompt_start;
+    modem_stats stats[MODEM_STATS_SLOTS];
+    int num_stats;
+    bool adaptive;
     char urc_buffer[URC_BUFFER_SIZE];
-    int urc_write;
-    int urc_read;
+    char urc_priority_buffer[URC_PRIORITY_SIZE];
+    char urc_line[URC_BUFFER_SIZE];     //popped URC being dispatched
+    URCQueue urcs;
+    URCQueue urcs_priority;
 };
@@ -0,0 +1,105 @@
+/*
+  URCQueue.cpp - Fixed capacity queue of length-prefixed URC records.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "URCQueue.h"
+
+#include <cstring>
+
+URCQueue::URCQueue()
+: storage(NULL), size(0), depth(0), head(0), used(0), records(0), high_water(0), drops(0) {
+}
+
+void URCQueue::init(char *storage, size_t size, int depth) {
+    this->storage = storage;
+    this->size = size;
+    this->depth = depth;
+    high_water = 0;
+    drops = 0;
+    clear();
+}
+
+void URCQueue::clear() {
+    head = 0;
+    used = 0;
+    records = 0;
+}
+
+bool URCQueue::fits(const char* line) const {
+    size_t len = strlen(line);
+    return len <= URC_RECORD_MAX && records < depth && used + len + 1 <= size;
+}
+
+bool URCQueue::push(const char* line) {
+    if(!fits(line)) {
+        drops++;
+        return false;
+    }
+    size_t len = strlen(line);
+    char l = (char)len;
+    copyIn(&l, 1);
+    copyIn(line, len);
+    records++;
+    if(records > high_water) high_water = records;
+    return true;
+}
+
+bool URCQueue::pop(char *line, size_t max) {
+    if(records == 0 || max == 0) return false;
+    char l;
+    copyOut(&l, 1);
+    size_t len = (uint8_t)l;
+    size_t keep = (len < max) ? len : max-1;
+    copyOut(line, keep);
+    line[keep] = 0;
+    //anything that did not fit in the caller's buffer is discarded
+    head = (head + (len - keep)) % size;
+    used -= len - keep;
+    records--;
+    return true;
+}
+
+bool URCQueue::dropOldest() {
+    if(records == 0) return false;
+    size_t len = (uint8_t)storage[head];
+    head = (head + len + 1) % size;
+    used -= len + 1;
+    records--;
+    drops++;
+    return true;
+}
+
+void URCQueue::copyIn(const char* src, size_t len) {
+    size_t tail = (head + used) % size;
+    size_t first = size - tail;
+    if(first > len) first = len;
+    memcpy(&storage[tail], src, first);
+    memcpy(storage, &src[first], len - first);
+    used += len;
+}
+
+void URCQueue::copyOut(char *dest, size_t len) {
+    size_t first = size - head;
+    if(first > len) first = len;
+    memcpy(dest, &storage[head], first);
+    memcpy(&dest[first], storage, len - first);
+    head = (head + len) % size;
+    used -= len;
+}
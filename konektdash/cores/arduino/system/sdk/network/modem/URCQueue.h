@@ -0,0 +1,58 @@
+/*
+  URCQueue.h - Fixed capacity queue of length-prefixed URC records.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+//records are a length byte followed by the line, no terminator
+#define URC_RECORD_MAX 255
+
+class URCQueue {
+public:
+    URCQueue();
+    void init(char *storage, size_t size, int depth);
+    void clear();
+
+    bool fits(const char* line) const;
+    bool push(const char* line);
+    bool pop(char *line, size_t max);
+    bool dropOldest();
+
+    int count() const               {return records;}
+    size_t bytes() const            {return used;}
+    uint32_t dropped() const        {return drops;}
+    int highWater() const           {return high_water;}
+
+protected:
+    void copyIn(const char* src, size_t len);
+    void copyOut(char *dest, size_t len);
+
+    char *storage;
+    size_t size;
+    int depth;
+    size_t head;
+    size_t used;
+    int records;
+    int high_water;
+    uint32_t drops;
+};
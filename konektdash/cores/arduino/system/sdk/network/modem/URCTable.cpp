@@ -0,0 +1,64 @@
+/*
+  URCTable.cpp - Sorted table of URC handlers, looked up by prefix.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "URCTable.h"
+
+#include <cstring>
+
+URCTable::URCTable()
+: entries(NULL), count(0), context(NULL) {
+}
+
+URCTable::URCTable(const urc_entry *entries, size_t count, void *context)
+: entries(entries), count(count), context(context) {
+}
+
+bool URCTable::isSorted() const {
+    for(size_t i=1; i<count; i++) {
+        if(strcmp(entries[i-1].prefix, entries[i].prefix) >= 0)
+            return false;
+    }
+    return true;
+}
+
+const urc_entry* URCTable::find(const char* prefix) const {
+    size_t lo = 0;
+    size_t hi = count;
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int c = strcmp(prefix, entries[mid].prefix);
+        if(c == 0) {
+            return &entries[mid];
+        } else if(c < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+bool URCTable::dispatch(const ATFields &fields) const {
+    const urc_entry *e = find(fields.prefix());
+    if(e == NULL || e->handler == NULL) return false;
+    e->handler(fields, context);
+    return true;
+}
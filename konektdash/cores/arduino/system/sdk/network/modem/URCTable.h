@@ -0,0 +1,47 @@
+/*
+  URCTable.h - Sorted table of URC handlers, looked up by prefix.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "ATFields.h"
+
+typedef void (*urc_handler)(const ATFields &fields, void *context);
+
+typedef struct {
+    const char* prefix;     //"+HHCONNECTED", tables are sorted by strcmp
+    urc_handler handler;
+}urc_entry;
+
+#define URC_TABLE_SIZE(table) (sizeof(table)/sizeof(urc_entry))
+
+class URCTable {
+public:
+    URCTable();
+    URCTable(const urc_entry *entries, size_t count, void *context=NULL);
+    bool isSorted() const;
+    const urc_entry* find(const char* prefix) const;
+    bool dispatch(const ATFields &fields) const;
+
+protected:
+    const urc_entry *entries;
+    size_t count;
+    void *context;
+};
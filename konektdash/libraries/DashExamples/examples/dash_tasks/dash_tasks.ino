@@ -0,0 +1,69 @@
+/*
+  dash_tasks.ino - run work from the main loop scheduler instead of loop()
+  Samples A01 every 100 ms within a 500 us budget, sends the average every
+  minute and prints how long each task took.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+uint32_t total = 0;
+uint32_t samples = 0;
+
+void sample(void *context) {
+  total += analogRead(A01);
+  samples++;
+}
+
+void report(void *context) {
+  if(samples == 0 || HologramCloud.sendBusy()) return;
+  HologramCloud.print(total / samples);
+  HologramCloud.attachTopic("A01");
+  HologramCloud.sendMessageAsync();
+  total = 0;
+  samples = 0;
+}
+
+void timing(void *context) {
+  for(int i=0; i<Tasks.numTasks(); i++) {
+    const task_stats *s = Tasks.getStats(i);
+    if(!s) continue;
+    Serial.print(Tasks.name(i));
+    Serial.print(" max us: ");
+    Serial.print(s->max_us);
+    Serial.print(" overruns: ");
+    Serial.print(s->overruns);
+    Serial.print(" misses: ");
+    Serial.println(s->misses);
+  }
+}
+
+void setup() {
+  //tasks are never interrupted, the budget and deadline only count
+  //how often a task ran too long or too late
+  Tasks.every("sample", 100, sample, NULL, 500);
+  Tasks.every("report", 60000, report);
+  Tasks.every("timing", 10000, timing);
+
+  //the charger only needs a look once a second
+  Tasks.setPeriod(Tasks.find("charger"), 1000);
+}
+
+void loop() {
+  //still runs on every pass, together with serialEvent and pollEvents
+}
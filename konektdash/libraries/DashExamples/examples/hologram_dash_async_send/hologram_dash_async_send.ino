@@ -0,0 +1,55 @@
+/*
+  hologram_dash_async_send.ino - keep sampling while a message uploads
+  This sketch samples A01 ten times a second and sends the averages every
+  minute without ever blocking on the network.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+uint32_t total = 0;
+uint32_t samples = 0;
+uint32_t last_sample = 0;
+uint32_t last_send = 0;
+
+void sent(bool success) {
+  Serial.println(success ? "Sent" : "Send failed");
+}
+
+void setup() {
+  HologramCloud.attachHandlerSent(sent);
+  HologramCloud.attachStickyTopic("A01");
+}
+
+void loop() {
+  if(millis() - last_sample >= 100) {
+    last_sample = millis();
+    total += analogRead(A01);
+    samples++;
+  }
+
+  //the previous message stays locked in the buffer until it is sent
+  if(millis() - last_send >= 60000 && !HologramCloud.sendBusy()) {
+    last_send = millis();
+    HologramCloud.print(total / samples);
+    HologramCloud.sendMessageAsync();
+    total = 0;
+    samples = 0;
+  }
+  //pollEvents runs after every loop and moves the send along
+}
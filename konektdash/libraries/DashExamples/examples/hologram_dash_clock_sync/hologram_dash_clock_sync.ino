@@ -0,0 +1,51 @@
+/*
+  hologram_dash_clock_sync.ino - timestamp readings from the RTC
+  The RTC is set from network time every six hours and its crystal drift is
+  corrected in between, so readings never wait on the modem for the time.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+void setup() {
+  HologramCloud.beginClockSync(6*60*60);
+}
+
+void loop() {
+  //reads the RTC once synced, asks the network until then
+  rtc_datetime_t now;
+  if(HologramCloud.getUTC(now)) {
+    Serial.print(now);
+    Serial.print(" A01: ");
+    Serial.println(analogRead(A01));
+  }
+
+  const clock_sync_stats &stats = HologramCloud.getClockSyncStats();
+  Serial.print("Offset at last sync: ");
+  Serial.print(stats.last_offset);
+  Serial.print(" s, drift compensation: ");
+  Serial.print(stats.drift_ppb);
+  Serial.println(" ppb");
+
+  //the sync schedule runs on the RTC, so it carries on across sleeps
+  Clock.setAlarmSecondsFromNow(60);
+  while(!Clock.alarmExpired()) {
+    HologramCloud.pollEvents();
+    Dash.sleep();
+  }
+}
@@ -171,10 +171,9 @@ void loop() {
   if(!Clock.alarmExpired())
     Dash.deepSleep();
 
-  //Manually turn the modem back on
-  //This is optional because the modem is automatically powered on when
-  //commands using the cell network are called, such as signal strength
-  //and sending messages.
+  //Manually turn the modem back on and wait for it. Commands using the
+  //cell network, such as signal strength and sending messages, also start
+  //it but fail until it is ready.
   HologramCloud.powerUp();
 }
 //After each loop, if the modem is powered, modem events are checked.
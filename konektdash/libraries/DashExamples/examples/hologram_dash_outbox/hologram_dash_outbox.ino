@@ -0,0 +1,55 @@
+/*
+  hologram_dash_outbox.ino - store readings in flash while out of coverage
+  This sketch queues a reading every minute. Queued messages survive a reset
+  and are sent in the background whenever the Dash is connected.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+void setup() {
+  //Keep the outbox in the last 32KB of DashFlash. Anything still queued
+  //from before a reset is picked up again here.
+  if(!HologramCloud.beginQueue()) {
+    Serial.println("Outbox unavailable");
+  }
+}
+
+void loop() {
+  HologramCloud.print("A01: ");
+  HologramCloud.println(analogRead(A01));
+  HologramCloud.attachTopic("A01");
+
+  //Never blocks on the network. When the outbox is full the oldest
+  //readings are overwritten.
+  HologramCloud.queueMessage();
+
+  const message_queue_stats &stats = HologramCloud.getQueueStats();
+  Serial.print("Queued: ");
+  Serial.print(stats.queued);
+  Serial.print(" dropped: ");
+  Serial.println(stats.dropped);
+
+  //pollEvents runs after every loop and sends queued messages while
+  //connected, keep the loop short so it gets the chance
+  Clock.setAlarmSecondsFromNow(60);
+  while(!Clock.alarmExpired()) {
+    HologramCloud.pollEvents();
+    Dash.sleep();
+  }
+}
@@ -0,0 +1,44 @@
+/*
+  hologram_dash_stream_log.ino - send a log kept in flash as one message
+  The log is read in small blocks and streamed to the system processor, so
+  it never has to fit in RAM.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#define LOG_ADDRESS 0x0
+#define LOG_LENGTH  8192
+
+void setup() {
+  Serial.begin(9600);
+}
+
+void loop() {
+  uint8_t block[64];
+
+  if(HologramCloud.beginMessage("log")) {
+    for(uint32_t offset = 0; offset < LOG_LENGTH; offset += sizeof(block)) {
+      DashFlash.read(LOG_ADDRESS + offset, block, sizeof(block));
+      HologramCloud.write(block, sizeof(block));
+    }
+    Serial.println(HologramCloud.endMessage() ? "Log sent" : "Log failed");
+  }
+
+  Dash.snooze(60*60*1000);
+}
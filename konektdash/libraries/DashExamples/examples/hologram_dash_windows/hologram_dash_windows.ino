@@ -0,0 +1,66 @@
+/*
+  hologram_dash_windows.ino - batch uploads into hourly transmission windows
+  This sketch deep sleeps between readings. The modem is only powered up
+  once an hour to send everything queued since, then shut down again.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#define READING_INTERVAL_S 600
+
+uint32_t next_reading = 0;
+
+void setup() {
+  HologramCloud.beginQueue();
+  //an hour apart, giving up after two minutes without coverage
+  HologramCloud.beginWindows(60*60, 2*60);
+}
+
+void loop() {
+  if((int32_t)(Clock.counter() - next_reading) >= 0) {
+    HologramCloud.print("A01: ");
+    HologramCloud.println(analogRead(A01));
+    HologramCloud.attachTopic("A01");
+    HologramCloud.queueMessage();
+    next_reading = Clock.counter() + READING_INTERVAL_S;
+  }
+
+  //pollEvents runs after every loop, stay awake while it drains the outbox
+  if(HologramCloud.isWindowOpen()) return;
+
+  const tx_window_stats &stats = HologramCloud.getWindowStats();
+  if(stats.windows > 0) {
+    Serial.print("Last window: ");
+    Serial.print(stats.sent);
+    Serial.print(" sent, modem on ");
+    Serial.print(stats.on_ms);
+    Serial.print(" ms, battery ");
+    Serial.print(stats.min_mv);
+    Serial.print(" mV, used ");
+    Serial.print(stats.charge_ppm);
+    Serial.println(" ppm");
+  }
+
+  //wake for whichever comes first, the next reading or the next window
+  uint32_t seconds = next_reading - Clock.counter();
+  uint32_t window = HologramCloud.secondsToWindow();
+  if(window < seconds) seconds = window;
+  if(seconds > READING_INTERVAL_S) seconds = READING_INTERVAL_S;
+  if(seconds > 0) Dash.deepSleepAtMostSec(seconds);
+}
@@ -30,6 +30,7 @@ DashTimerProvider DashTimer;
 DashClockProvider DashClock;
 DashChargerProvider DashCharger;
 DashModemProvider DashModem;
+DashStatsProvider DashStats;
 
 void DashReadEvalPrintLoop::begin()
 {
@@ -41,6 +42,7 @@ void DashReadEvalPrintLoop::begin()
     addProvider(DashClock);
     addProvider(DashCharger);
     addProvider(DashModem);
+    addProvider(DashStats);
 }
 
 void DashReadEvalPrintLoop::sleep()
@@ -142,8 +144,7 @@ bool DashCloudProvider::event(ReadEvalPrintEvent &event, Print &port)
 
     case 5: //cloud on
         port.print("Waking up... ");
-        HologramCloud.powerUp();
-        port.println("Done");
+        port.println(HologramCloud.powerUp() ? "Done" : "Still starting");
         break;
     case 6: //cloud off
         port.print("Shutting Down... ");
@@ -862,3 +863,183 @@ bool DashChargerProvider::event(ReadEvalPrintEvent &event, Print &port)
 
     return true;
 }
+
+static const ReadEvalPrintCommand STATS[] = {
+    {2, 0, "per command modem statistics",              "stats", "modem"},                          //0
+    {2, 0, "message and connection statistics",         "stats", "cloud"},                          //1
+    {2, 0, "clear all statistics",                      "stats", "reset"},                          //2
+    {2, 0, "main loop task timing",                     "stats", "tasks"},                          //3
+    {2, 0, "RTC sync and drift compensation",           "stats", "clock"},                          //4
+    {2, 0, "transmission windows and battery use",      "stats", "window"},                         //5
+};
+
+const ReadEvalPrintCommand* DashStatsProvider::getTable(uint32_t *num_commands)
+{
+    *num_commands = sizeof(STATS)/sizeof(ReadEvalPrintCommand);
+    return STATS;
+}
+
+void DashStatsProvider::printModem(Print &port)
+{
+    port.println("command         calls  ok     error  timeout retry  min    avg    max    srtt (ms)");
+    for(int i=0; i<modem.numStats(); i++) {
+        const modem_stats *s = modem.getStats(i);
+        char line[104];
+        snprintf(line, sizeof(line), "%-15s %-6lu %-6lu %-6lu %-7lu %-6lu %-6lu %-6lu %-6lu %lu",
+                 s->cmd[0] ? s->cmd : "AT",
+                 (unsigned long)s->calls, (unsigned long)s->ok, (unsigned long)s->errors,
+                 (unsigned long)s->timeouts, (unsigned long)s->retries,
+                 (unsigned long)s->min_ms, (unsigned long)(s->total_ms/s->calls),
+                 (unsigned long)s->max_ms, (unsigned long)s->srtt_ms);
+        port.println(line);
+    }
+    port.print("URCs dropped: ");
+    port.print(modem.urcDropCount());
+    port.print(" high water: ");
+    port.print(modem.urcHighWater());
+    port.print(" priority dropped: ");
+    port.print(modem.urcPriorityDropCount());
+    port.print(" high water: ");
+    port.println(modem.urcPriorityHighWater());
+}
+
+void DashStatsProvider::printCloud(Print &port)
+{
+    const cloud_stats &s = HologramCloud.getStats();
+    port.print("Messages: ");
+    port.print(s.messages);
+    port.print(" failed: ");
+    port.println(s.message_failures);
+    port.print("Bytes written: ");
+    port.println(s.write_bytes);
+    port.print("Send time: ");
+    port.print(s.send_ms);
+    port.print(" ms, max ");
+    port.print(s.send_max_ms);
+    port.println(" ms");
+    port.print("Reconnects: ");
+    port.print(s.reconnects);
+    port.print(" resets: ");
+    port.print(s.resets);
+    port.print(" failed probes: ");
+    port.println(s.probe_failures);
+    port.print("Batched records: ");
+    port.println(s.records);
+    port.print("Compressed: ");
+    port.print(s.compressed);
+    port.print(" bytes saved: ");
+    port.println(s.compress_saved);
+    port.print("Topics reused: ");
+    port.print(s.topics_reused);
+    port.print(" cached answers: ");
+    port.println(s.cache_hits);
+    if(HologramCloud.isQueueReady()) {
+        const message_queue_stats &q = HologramCloud.getQueueStats();
+        port.print("Queued: ");
+        port.print(q.queued);
+        port.print(" high water: ");
+        port.print(q.high_water);
+        port.print(" sent: ");
+        port.print(q.removed);
+        port.print(" dropped: ");
+        port.print(q.dropped);
+        port.print(" rejected: ");
+        port.println(q.rejected);
+    }
+}
+
+bool DashStatsProvider::event(ReadEvalPrintEvent &event, Print &port)
+{
+    switch(event.commandIndex()) {
+    case 0: //stats modem
+        printModem(port);
+        break;
+    case 1: //stats cloud
+        printCloud(port);
+        break;
+    case 2: //stats reset
+        HologramCloud.resetStats();
+        Tasks.resetStats();
+        port.println("Statistics cleared");
+        break;
+    case 3: //stats tasks
+        printTasks(port);
+        break;
+    case 4: //stats clock
+        printClock(port);
+        break;
+    case 5: //stats window
+        printWindow(port);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+void DashStatsProvider::printTasks(Print &port)
+{
+    for(int i=0; i<Tasks.numTasks(); i++) {
+        const task_stats *s = Tasks.getStats(i);
+        if(!s) continue;
+        port.print(Tasks.name(i));
+        port.print(": runs ");
+        port.print(s->runs);
+        port.print(" avg ");
+        port.print(s->runs ? s->total_us / s->runs : 0);
+        port.print(" us, max ");
+        port.print(s->max_us);
+        port.print(" us, overruns ");
+        port.print(s->overruns);
+        port.print(" misses ");
+        port.println(s->misses);
+    }
+}
+
+void DashStatsProvider::printClock(Print &port)
+{
+    const clock_sync_stats &s = HologramCloud.getClockSyncStats();
+    port.print("Synced: ");
+    port.print(HologramCloud.isClockSynced() ? "yes" : "no");
+    port.print(" syncs: ");
+    port.print(s.syncs);
+    port.print(" failed: ");
+    port.print(s.failures);
+    port.print(" steps: ");
+    port.println(s.steps);
+    port.print("Last offset: ");
+    port.print(s.last_offset);
+    port.print(" s drift: ");
+    port.print(s.drift_ppb);
+    port.println(" ppb");
+}
+
+void DashStatsProvider::printWindow(Print &port)
+{
+    const tx_window_stats &s = HologramCloud.getWindowStats();
+    port.print("Windows: ");
+    port.print(s.windows);
+    port.print(" skipped: ");
+    port.print(s.skipped);
+    port.print(" timed out: ");
+    port.print(s.timeouts);
+    port.print(" next in: ");
+    port.print(HologramCloud.secondsToWindow());
+    port.println(" s");
+    port.print("Last window sent: ");
+    port.print(s.sent);
+    port.print(" on: ");
+    port.print(s.on_ms);
+    port.print(" ms battery: ");
+    port.print(s.start_mv);
+    port.print(" mV, min ");
+    port.print(s.min_mv);
+    port.print(" mV, used ");
+    port.print(s.charge_ppm);
+    port.println(" ppm");
+    port.print("Total on: ");
+    port.print(s.total_on_ms);
+    port.print(" ms used: ");
+    port.print(s.total_charge_ppm);
+    port.println(" ppm");
+}
@@ -101,3 +101,17 @@ public:
     virtual bool event(ReadEvalPrintEvent &event, Print &port);
     virtual const char* getHelpHeader() {return "Battery and Charger";}
 };
+
+class DashStatsProvider : public ReadEvalPrintProvider
+{
+public:
+    virtual const ReadEvalPrintCommand* getTable(uint32_t *num_commands);
+    virtual bool event(ReadEvalPrintEvent &event, Print &port);
+    virtual const char* getHelpHeader() {return "Link Statistics";}
+protected:
+    void printModem(Print &port);
+    void printCloud(Print &port);
+    void printTasks(Print &port);
+    void printClock(Print &port);
+    void printWindow(Print &port);
+};
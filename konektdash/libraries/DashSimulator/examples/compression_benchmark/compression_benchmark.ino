@@ -0,0 +1,60 @@
+/*
+  compression_benchmark.ino - compression ratio and cycles per byte of the
+  LZSS stage used by HologramCloud.setCompressor on typical payloads.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <DashSimulator.h>
+
+uint32_t cycles() {
+  return DWT->CYCCNT;
+}
+
+CompressionBenchmark bench(cycles);
+
+const uint32_t SIZES[] = {256, 1024, 4096};
+
+void setup() {
+  Serial.begin(); /* USB Serial */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  Dash.snooze(5000); //time to open the terminal
+}
+
+void loop() {
+  Serial.println("payload         bytes  packed  saved  cycles/B  expand/B  ok");
+  for(int i=0; i<bench.numSuites(); i++) {
+    for(int s=0; s<3; s++) {
+      compression_result r;
+      bench.run(i, SIZES[s], r);
+      Serial.print(r.name);
+      for(int pad=strlen(r.name); pad<16; pad++) Serial.write(' ');
+      Serial.print(r.input); Serial.write('\t');
+      Serial.print(r.output); Serial.write('\t');
+      Serial.print(CompressionBenchmark::percentSaved(r)); Serial.print("%\t");
+      Serial.print(CompressionBenchmark::cyclesPerByte(r.compress_cycles, r)); Serial.write('\t');
+      Serial.print(CompressionBenchmark::cyclesPerByte(r.decompress_cycles, r)); Serial.write('\t');
+      Serial.println(r.ok ? "yes" : "NO");
+    }
+  }
+  Serial.println();
+  Dash.snooze(10000);
+}
@@ -0,0 +1,53 @@
+/*
+  encoding_benchmark.ino - bytes and cycles per reading when a sketch builds
+  its payload as a String of JSON versus with CBOREncoder.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <DashSimulator.h>
+
+uint32_t cycles() {
+  return DWT->CYCCNT;
+}
+
+EncodingBenchmark bench(cycles);
+
+void setup() {
+  Serial.begin(); /* USB Serial */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  Dash.snooze(5000); //time to open the terminal
+}
+
+void loop() {
+  Serial.println("encoder         bytes/reading  cycles/reading  ok");
+  for(int i=0; i<bench.numSuites(); i++) {
+    encoding_result r;
+    bench.run(i, r);
+    Serial.print(r.name);
+    for(int pad=strlen(r.name); pad<16; pad++) Serial.write(' ');
+    Serial.print(EncodingBenchmark::bytesPerRecord(r)); Serial.print("\t\t");
+    Serial.print(EncodingBenchmark::cyclesPerRecord(r)); Serial.print("\t\t");
+    Serial.println(r.ok ? "yes" : "NO");
+  }
+  Serial.println();
+  Dash.snooze(10000);
+}
@@ -0,0 +1,79 @@
+/*
+  late_reply.ino - checks that a reply arriving after the adaptive timeout
+  has given up on it is not mistaken for the answer to a later command.
+  The simulator first answers +CSQ quickly so the modem learns a short
+  timeout, then delays one reply past it.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <DashSimulator.h>
+
+class IgnoreURCs : public URCReceiver {
+public:
+  virtual void onURC(const char* urc) {}
+};
+
+SystemSimulator sim;
+SimulatedModem simmodem(sim);
+IgnoreURCs receiver;
+int failures = 0;
+
+void check(const char* what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? " PASS" : " FAIL");
+  if(!ok) failures++;
+}
+
+void setup() {
+  Serial.begin(); /* USB Serial */
+  Dash.snooze(5000); //time to open the terminal
+
+  sim.setLatency(20);
+  simmodem.begin(receiver);
+  for(int i=0; i<8; i++) {
+    simmodem.command("+CSQ", 1000, 2);
+  }
+  uint32_t shortened = simmodem.adaptiveTimeout("+CSQ", 1000);
+  Serial.print("+CSQ attempt timeout ");
+  Serial.println(shortened);
+  check("timeout shortened", shortened < 1000);
+
+  //the next reply misses the shortened timeout but not MODEM_LATE_MS
+  sim.script("+CSQ", SIM_RESPOND, shortened + MODEM_LATE_MS/2, 1);
+  modem_result r = simmodem.command("+CSQ", 1000, 2);
+  check("late reply taken", r == MODEM_OK && strcmp(simmodem.lastResponse(), "+CSQ: 20,99") == 0);
+
+  //the command after it gets its own reply, not a leftover, even when
+  //that reply takes longer than the late one
+  sim.script("+HCONSTATUS", SIM_RESPOND, MODEM_LATE_MS, 1);
+  r = simmodem.command("+HCONSTATUS", 1000);
+  check("next reply aligned", r == MODEM_OK && strcmp(simmodem.lastResponse(), "+HCONSTATUS: 1") == 0);
+
+  const modem_stats *s = simmodem.getStats("+CSQ");
+  Serial.print("+CSQ retries ");
+  Serial.print(s->retries);
+  Serial.print(" timeouts ");
+  Serial.println(s->timeouts);
+  Serial.println(failures ? "FAILED" : "PASSED");
+}
+
+void loop() {
+  Dash.snooze(1000);
+}
@@ -0,0 +1,54 @@
+/*
+  modem_benchmark.ino - time the AT command engine in the Modem layer.
+  Each suite replays canned system processor responses and reports calls
+  per second, bytes parsed per second and per-call latency percentiles.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <DashSimulator.h>
+
+uint32_t benchmark_clock() {
+  return micros();
+}
+
+ModemBenchmark bench(benchmark_clock);
+
+void setup() {
+  Serial.begin(); /* USB Serial */
+  Dash.snooze(5000); //time to open the terminal
+}
+
+void loop() {
+  Serial.println("suite                   calls/s   bytes/s   p50us   p99us   maxus  errors");
+  for(int i=0; i<bench.numSuites(); i++) {
+    benchmark_result r;
+    bench.run(i, r);
+    Serial.print(r.name);
+    for(int pad=strlen(r.name); pad<22; pad++) Serial.write(' ');
+    Serial.print(ModemBenchmark::callsPerSecond(r)); Serial.write('\t');
+    Serial.print(ModemBenchmark::bytesPerSecond(r)); Serial.write('\t');
+    Serial.print(r.p50_us); Serial.write('\t');
+    Serial.print(r.p99_us); Serial.write('\t');
+    Serial.print(r.max_us); Serial.write('\t');
+    Serial.println(r.errors);
+  }
+  Serial.println();
+  Dash.snooze(10000);
+}
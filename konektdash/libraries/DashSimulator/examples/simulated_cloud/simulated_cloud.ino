@@ -0,0 +1,70 @@
+/*
+  simulated_cloud.ino - run HologramCloud against the simulated system
+  processor instead of the cellular module. Scripts a slow send, an error
+  and an inbound message, and reports the results on the USB Serial port.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <DashSimulator.h>
+
+SimulatedSystemSerial SimSystem;
+
+char buffer_inbound[256];
+
+void cloud_inbound(int length) {
+  buffer_inbound[length] = 0;
+  Serial.print("Inbound: ");
+  Serial.println(buffer_inbound);
+}
+
+void report(const char* what, bool ok) {
+  Serial.print(what);
+  Serial.println(ok ? " OK" : " FAILED");
+}
+
+void setup() {
+  Serial.begin(); /* USB Serial */
+
+  //every response takes 20ms, +HMSEND takes 2 seconds
+  SimSystem.setLatency(20);
+  SimSystem.setSendLatency(2000);
+
+  //Point the cloud at the simulator instead of SerialSystem
+  HologramCloud.begin(SimSystem);
+  HologramCloud.attachHandlerInbound(cloud_inbound, buffer_inbound, sizeof(buffer_inbound)-1);
+
+  report("Send", HologramCloud.sendMessage("Simulated hello", "sim"));
+  Serial.print("Simulator received ");
+  Serial.print(SimSystem.lastMessageLength());
+  Serial.println(" bytes");
+
+  //the next send fails on the system side
+  SimSystem.script("+HMSEND", SIM_ERROR, 50, 1);
+  report("Scripted error send", !HologramCloud.sendMessage("Simulated failure"));
+
+  //a cloud-to-device message arrives in 500ms
+  const char inbound[] = "inbound from the simulator";
+  SimSystem.injectInbound((const uint8_t*)inbound, strlen(inbound), 500);
+}
+
+void loop() {
+  //After each loop, HologramCloud.pollEvents() services the simulator
+  Dash.snooze(100);
+}
@@ -0,0 +1,62 @@
+/*
+  upload_benchmark.ino - compare serial and pipelined +HMWRITE uploads of a
+  4KB message at different chunk sizes, then a whole HologramCloud
+  sendMessage of it. Times are simulated link time at 115200 baud with 5ms
+  of system processor latency per response.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <DashSimulator.h>
+
+UploadBenchmark bench;
+
+const uint32_t CHUNKS[] = {128, 256, 512};
+
+void setup() {
+  Serial.begin(); /* USB Serial */
+  Dash.snooze(5000); //time to open the terminal
+}
+
+void printResult(const benchmark_result &r, uint32_t chunk) {
+  Serial.print(r.name);
+  for(int pad=strlen(r.name); pad<22; pad++) Serial.write(' ');
+  Serial.print(chunk); Serial.write('\t');
+  Serial.print(ModemBenchmark::bytesPerSecond(r)); Serial.write('\t');
+  Serial.print(r.p50_us); Serial.write('\t');
+  Serial.print(r.p99_us); Serial.write('\t');
+  Serial.println(r.errors);
+}
+
+void loop() {
+  Serial.println("mode                  chunk   bytes/s   p50us   p99us  errors");
+  for(int i=0; i<3; i++) {
+    for(int pipeline=0; pipeline<2; pipeline++) {
+      benchmark_result r;
+      bench.run(4096, CHUNKS[i], pipeline, r);
+      printResult(r, CHUNKS[i]);
+    }
+  }
+  //+HMRST, the +HMWRITEs and +HMSEND, chunked the way HologramCloud picks
+  benchmark_result r;
+  bench.runMessage(4096, r);
+  printResult(r, HMWRITE_CHUNK_V2);
+  Serial.println();
+  Dash.snooze(10000);
+}
@@ -0,0 +1,117 @@
+/*
+  CompressionBenchmark.cpp - ratio and cycles per byte of the LZSS stage on
+  payloads shaped like typical Dash uploads.
+
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "CompressionBenchmark.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const char* SUITES[] = {
+    "JSON readings",
+    "CSV readings",
+    "Print report",
+    "random bytes",
+};
+
+CompressionBenchmark::CompressionBenchmark(uint32_t (*cycleTick)(void))
+: cycleTick(cycleTick), seed(1) {
+}
+
+int CompressionBenchmark::numSuites() {
+    return sizeof(SUITES)/sizeof(SUITES[0]);
+}
+
+bool CompressionBenchmark::run(int suite, uint32_t length, compression_result &result) {
+    if(suite < 0 || suite >= numSuites()) return false;
+    if(length > COMPRESSION_BENCHMARK_SIZE) length = COMPRESSION_BENCHMARK_SIZE;
+
+    result.name = SUITES[suite];
+    result.input = generate(suite, length);
+
+    uint32_t start = cycleTick();
+    lzss.begin(payload, result.input);
+    result.output = lzss.read(compressed, sizeof(compressed));
+    result.compress_cycles = cycleTick() - start;
+
+    start = cycleTick();
+    int32_t n = LZSS::decompress(compressed, result.output, restored, sizeof(restored));
+    result.decompress_cycles = cycleTick() - start;
+
+    result.ok = lzss.done() && n == (int32_t)result.input && memcmp(payload, restored, result.input) == 0;
+    return true;
+}
+
+uint32_t CompressionBenchmark::percentSaved(const compression_result &result) {
+    if(result.input == 0 || result.output >= result.input) return 0;
+    return (result.input - result.output) * 100 / result.input;
+}
+
+uint32_t CompressionBenchmark::cyclesPerByte(uint32_t cycles, const compression_result &result) {
+    return result.input ? cycles / result.input : 0;
+}
+
+//fill the payload with whole records up to length, returns the bytes used
+uint32_t CompressionBenchmark::generate(int suite, uint32_t length) {
+    uint32_t used = 0;
+    uint32_t t = 1498000000;
+    seed = 1;
+    while(used < length) {
+        char line[96];
+        int n = 0;
+        int temp = 180 + random() % 60;
+        int hum = 400 + random() % 200;
+        int bat = 60 + random() % 40;
+        switch(suite) {
+        case 0:
+            n = snprintf(line, sizeof(line), "{\"t\":%lu,\"temp\":%d.%d,\"hum\":%d.%d,\"bat\":%d}\n",
+                         (unsigned long)t, temp/10, temp%10, hum/10, hum%10, bat);
+            break;
+        case 1:
+            n = snprintf(line, sizeof(line), "%lu,%d.%d,%d.%d,%d\n",
+                         (unsigned long)t, temp/10, temp%10, hum/10, hum%10, bat);
+            break;
+        case 2:
+            n = snprintf(line, sizeof(line), "A01: %d\r\nBattery: %d%%\r\nSignal Strength: %d\r\n",
+                         (int)(random() % 4096), bat, (int)(10 + random() % 20));
+            break;
+        default:
+            for(n=0; n<(int)sizeof(line); n++) {
+                line[n] = random() >> 8;
+            }
+            break;
+        }
+        if(used + n > length) {
+            if(used > 0) break;
+            n = length;
+        }
+        memcpy(&payload[used], line, n);
+        used += n;
+        t += 60;
+    }
+    return used;
+}
+
+uint32_t CompressionBenchmark::random() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
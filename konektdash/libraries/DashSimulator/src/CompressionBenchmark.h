@@ -0,0 +1,62 @@
+/*
+  CompressionBenchmark.h - ratio and cycles per byte of the LZSS stage on
+  payloads shaped like typical Dash uploads.
+
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "system/sdk/compress/LZSS.h"
+
+#ifndef COMPRESSION_BENCHMARK_SIZE
+#define COMPRESSION_BENCHMARK_SIZE 4096
+#endif
+
+typedef struct {
+    const char* name;
+    uint32_t input;
+    uint32_t output;                //compressed size, header included
+    uint32_t compress_cycles;
+    uint32_t decompress_cycles;
+    bool ok;                        //round trip matched
+}compression_result;
+
+class CompressionBenchmark {
+public:
+    //cycleTick is any free running counter, DWT->CYCCNT on the Dash
+    CompressionBenchmark(uint32_t (*cycleTick)(void));
+
+    int numSuites();
+    bool run(int suite, uint32_t length, compression_result &result);
+
+    static uint32_t percentSaved(const compression_result &result);
+    static uint32_t cyclesPerByte(uint32_t cycles, const compression_result &result);
+
+protected:
+    uint32_t generate(int suite, uint32_t length);
+    uint32_t random();
+
+    uint32_t (*cycleTick)(void);
+    uint32_t seed;
+    LZSS lzss;
+    uint8_t payload[COMPRESSION_BENCHMARK_SIZE];
+    uint8_t compressed[COMPRESSION_BENCHMARK_SIZE + COMPRESSION_BENCHMARK_SIZE/8 + 16];
+    uint8_t restored[COMPRESSION_BENCHMARK_SIZE];
+};
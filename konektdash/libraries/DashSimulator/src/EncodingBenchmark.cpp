@@ -0,0 +1,105 @@
+/*
+  EncodingBenchmark.cpp - size and cycles of building a reading as a String
+  of JSON versus encoding it with CBOREncoder.
+
+
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "EncodingBenchmark.h"
+
+#include <cstring>
+
+static const char* SUITES[] = {
+    "String JSON",
+    "CBOREncoder",
+};
+
+size_t BufferPrint::write(const uint8_t *data, size_t size) {
+    if(size > sizeof(buffer) - length) size = sizeof(buffer) - length;
+    memcpy(&buffer[length], data, size);
+    length += size;
+    return size;
+}
+
+EncodingBenchmark::EncodingBenchmark(uint32_t (*cycleTick)(void))
+: cycleTick(cycleTick) {
+}
+
+int EncodingBenchmark::numSuites() {
+    return sizeof(SUITES)/sizeof(SUITES[0]);
+}
+
+bool EncodingBenchmark::run(int suite, encoding_result &result, uint32_t records) {
+    if(suite < 0 || suite >= numSuites()) return false;
+
+    result.name = SUITES[suite];
+    result.records = records;
+    result.bytes = 0;
+    result.cycles = 0;
+    result.ok = true;
+
+    for(uint32_t i=0; i<records; i++) {
+        sink.clear();
+        uint32_t start = cycleTick();
+        bool ok = suite == 0 ? encodeString(i) : encodeCBOR(i);
+        result.cycles += cycleTick() - start;
+        result.bytes += sink.length;
+        result.ok = result.ok && ok;
+    }
+    return true;
+}
+
+uint32_t EncodingBenchmark::bytesPerRecord(const encoding_result &result) {
+    return result.records ? result.bytes / result.records : 0;
+}
+
+uint32_t EncodingBenchmark::cyclesPerRecord(const encoding_result &result) {
+    return result.records ? result.cycles / result.records : 0;
+}
+
+//the usual sketch pattern: concatenate, then sendMessage(String) copies it
+bool EncodingBenchmark::encodeString(uint32_t i) {
+    String s = "{\"t\":";
+    s += 1498000000UL + i*60;
+    s += ",\"temp\":";
+    s += String(21.4f + (i % 7) * 0.1f, 1);
+    s += ",\"hum\":";
+    s += String(45.2f - (i % 5) * 0.3f, 1);
+    s += ",\"bat\":";
+    s += (int)(87 - i % 3);
+    s += ",\"id\":\"dash-01\"}";
+    return sink.write((const uint8_t*)s.c_str(), s.length()) == s.length();
+}
+
+bool EncodingBenchmark::encodeCBOR(uint32_t i) {
+    CBOREncoder cbor(sink);
+    cbor.beginMap(5);
+    cbor.add("t");
+    cbor.add(1498000000UL + i*60);
+    cbor.add("temp");
+    cbor.add(21.4f + (i % 7) * 0.1f);
+    cbor.add("hum");
+    cbor.add(45.2f - (i % 5) * 0.3f);
+    cbor.add("bat");
+    cbor.add((int)(87 - i % 3));
+    cbor.add("id");
+    cbor.add("dash-01");
+    return cbor.ok();
+}
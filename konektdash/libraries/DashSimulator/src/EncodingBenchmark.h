@@ -0,0 +1,76 @@
+/*
+  EncodingBenchmark.h - size and cycles of building a reading as a String of
+  JSON versus encoding it with CBOREncoder.
+
+
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "Print.h"
+#include "CBOREncoder.h"
+
+#ifndef ENCODING_BENCHMARK_SIZE
+#define ENCODING_BENCHMARK_SIZE 256
+#endif
+
+#ifndef ENCODING_BENCHMARK_RECORDS
+#define ENCODING_BENCHMARK_RECORDS 100
+#endif
+
+typedef struct {
+    const char* name;
+    uint32_t records;
+    uint32_t bytes;                 //total encoded
+    uint32_t cycles;                //total, copy into the sink included
+    bool ok;
+}encoding_result;
+
+//stands in for the message buffer the encoded reading ends up in
+class BufferPrint : public Print {
+public:
+    BufferPrint() : length(0) {}
+    virtual size_t write(uint8_t b) {return write(&b, 1);}
+    virtual size_t write(const uint8_t *data, size_t size);
+    using Print::write;
+    void clear() {length = 0;}
+
+    uint8_t buffer[ENCODING_BENCHMARK_SIZE];
+    size_t length;
+};
+
+class EncodingBenchmark {
+public:
+    //cycleTick is any free running counter, DWT->CYCCNT on the Dash
+    EncodingBenchmark(uint32_t (*cycleTick)(void));
+
+    int numSuites();
+    bool run(int suite, encoding_result &result, uint32_t records=ENCODING_BENCHMARK_RECORDS);
+
+    static uint32_t bytesPerRecord(const encoding_result &result);
+    static uint32_t cyclesPerRecord(const encoding_result &result);
+
+protected:
+    bool encodeString(uint32_t i);
+    bool encodeCBOR(uint32_t i);
+
+    uint32_t (*cycleTick)(void);
+    BufferPrint sink;
+};
@@ -0,0 +1,292 @@
+/*
+  ModemBenchmark.cpp - Measures the AT command engine in Modem by
+  replaying canned system processor responses, so only the parsing and
+  dispatch cost of the Modem layer is timed.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "ModemBenchmark.h"
+
+#include <cstring>
+#include <cstdio>
+
+typedef struct {
+    const char* name;
+    const char* script;
+    modem_result expected;
+}benchmark_suite;
+
+static const benchmark_suite SUITES[] = {
+    {"command +CSQ",        "\r\n+CSQ: 20,99\r\n\r\nOK\r\n",                                    MODEM_OK},
+    {"query +HOLO",         "\r\n+HOLO: 2\r\n\r\nOK\r\n",                                       MODEM_OK},
+    {"set +HSOCKLISTEN",    "\r\n+HSOCKLISTEN: 1\r\n\r\nOK\r\n",                                MODEM_OK},
+    {"+HMWRITE 128",        "@\r\nOK\r\n",                                                      MODEM_OK},
+    {"command +CME ERROR",  "\r\n+CME ERROR: 100\r\n",                                          MODEM_ERROR},
+    {"command with 2 URCs", "\r\n+HHREGISTERED: 1\r\n\r\n+CSQ: 20,99\r\n"
+                            "\r\n+HHCONNECTED: 1\r\n\r\nOK\r\n",                                MODEM_OK},
+    {"checkURC x4",         "\r\n+HHREGISTERED: 1\r\n\r\n+HHCONNECTED: 1\r\n"
+                            "\r\n+HHCHARGE: 2\r\n\r\n+HHSOCKACCEPT: 1,\"10.0.0.1\",4010,0\r\n",    MODEM_OK},
+    {"+HSOCKREAD 200 hex",  NULL,                                                               MODEM_OK},
+    {"+HSOCKREAD streamed", NULL,                                                               MODEM_OK},
+    {"parse +CSQ sscanf",   "+CSQ: 20,99",                                                      MODEM_OK},
+    {"parse +CSQ fields",   "+CSQ: 20,99",                                                      MODEM_OK},
+    {"parse +CCLK sscanf",  "+CCLK: \"17/06/01,12:34:56-32\"",                                  MODEM_OK},
+    {"parse +CCLK fields",  "+CCLK: \"17/06/01,12:34:56-32\"",                                  MODEM_OK},
+    {"parse +HSYS sscanf",  "+HSYS: 2,\"0.9.12\"",                                              MODEM_OK},
+    {"parse +HSYS fields",  "+HSYS: 2,\"0.9.12\"",                                              MODEM_OK},
+};
+
+#define NUM_SUITES (int)(sizeof(SUITES)/sizeof(benchmark_suite))
+
+static void countURC(const ATFields &fields, void *context) {
+    (*(uint32_t*)context)++;
+}
+
+//same prefixes as HologramCloud
+static const urc_entry URCS[] = {
+    {"+HHCHARGE",       countURC},
+    {"+HHCONNECTED",    countURC},
+    {"+HHLOC",          countURC},
+    {"+HHOLO",          countURC},
+    {"+HHREGISTERED",   countURC},
+    {"+HHSMSCTX",       countURC},
+    {"+HHSMSRX",        countURC},
+    {"+HHSOCKACCEPT",   countURC},
+};
+
+//the sscanf paths Hologram used before ATFields, kept as a baseline
+static modem_result scanCSQ(const char* line) {
+    int rssi = 99, qual = 0;
+    if(sscanf(line, "+CSQ: %d,%d", &rssi, &qual) != 2) return MODEM_ERROR;
+    return rssi == 20 ? MODEM_OK : MODEM_ERROR;
+}
+
+static modem_result fieldsCSQ(ATFields &fields, const char* line) {
+    if(!fields.parse(line) || !fields.is("+CSQ")) return MODEM_ERROR;
+    return fields.toInt(0, 99) == 20 ? MODEM_OK : MODEM_ERROR;
+}
+
+static modem_result scanCCLK(const char* line) {
+    int year, month, day, hour, minute, second, tz;
+    if(sscanf(line, "+CCLK: \"%d/%d/%d,%d:%d:%d%d", &year, &month, &day, &hour, &minute, &second, &tz) != 7)
+        return MODEM_ERROR;
+    return (second == 56 && tz == -32) ? MODEM_OK : MODEM_ERROR;
+}
+
+static modem_result fieldsCCLK(ATFields &fields, const char* line) {
+    at_date date;
+    if(!fields.parse(line) || !fields.is("+CCLK") || !fields.toDate(0, date)) return MODEM_ERROR;
+    return (date.second == 56 && date.tz == -32) ? MODEM_OK : MODEM_ERROR;
+}
+
+static modem_result scanHSYS(const char* line) {
+    int value = 0;
+    char ver[9];
+    if(sscanf(line, "+HSYS: %d,\"%8[^\"]\"", &value, ver) != 2) return MODEM_ERROR;
+    return (value == 2 && ver[0] == '0') ? MODEM_OK : MODEM_ERROR;
+}
+
+static modem_result fieldsHSYS(ATFields &fields, const char* line) {
+    if(!fields.parse(line) || !fields.is("+HSYS") || fields.count() != 2) return MODEM_ERROR;
+    return (fields.toInt(0) == 2 && fields.str(1)[0] == '0') ? MODEM_OK : MODEM_ERROR;
+}
+
+static uint8_t payload[128];
+static uint8_t inbound[200];
+
+ModemBenchmark::ModemBenchmark(uint32_t (*usTick)(void))
+: usTick(usTick), script_length(0), script_read(0), consumed(0), urcs(0), armed(false) {
+    init(*this);
+}
+
+int ModemBenchmark::numSuites() {
+    return NUM_SUITES;
+}
+
+uint32_t ModemBenchmark::msTick() {
+    return usTick()/1000;
+}
+
+void ModemBenchmark::onURC(const char* urc) {
+    if(fields.parse(urc)) {
+        URCTable(URCS, URC_TABLE_SIZE(URCS), &urcs).dispatch(fields);
+    }
+}
+
+void ModemBenchmark::modemout(const char* str) {
+    //responses are released once the command line is terminated
+    if(strcmp(str, "\r\n") == 0)
+        armed = true;
+}
+
+int ModemBenchmark::modemavailable() {
+    return armed ? script_length - script_read : 0;
+}
+
+uint8_t ModemBenchmark::modemread() {
+    if(script_read == script_length) return 0;
+    consumed++;
+    return script[script_read++];
+}
+
+uint8_t ModemBenchmark::modempeek() {
+    if(script_read == script_length) return 0;
+    return script[script_read];
+}
+
+void ModemBenchmark::load(const char* s) {
+    script_length = strlen(s);
+    memcpy(script, s, script_length);
+    script_read = 0;
+    armed = false;
+}
+
+modem_result ModemBenchmark::step(int suite) {
+    switch(suite) {
+        case 0:
+            return command("+CSQ");
+        case 1:
+            return query("+HOLO");
+        case 2:
+            return set("+HSOCKLISTEN", "4010");
+        case 3:
+        {
+            startSet("+HMWRITE");
+            appendSet((int)sizeof(payload));
+            modem_result r = intermediateSet('@');
+            if(r != MODEM_OK) return r;
+            dataWrite(payload, sizeof(payload));
+            return waitSetComplete();
+        }
+        case 4:
+            return command("+CSQ");
+        case 5:
+        {
+            modem_result r = command("+CSQ");
+            checkURC();
+            return r;
+        }
+        case 6:
+            armed = true;
+            checkURC();
+            return MODEM_OK;
+        case 7:
+        {
+            //line buffered path: copy the response, then decode it
+            modem_result r = set("+HSOCKREAD", "1,200,10000,1");
+            const char* q = strchr(lastResponse(), '"');
+            if(r == MODEM_OK && q) {
+                for(uint32_t i=0; i<sizeof(inbound); i++)
+                    inbound[i] = convertHex(&q[1+i*2]);
+            }
+            return r;
+        }
+        case 8:
+        {
+            int length;
+            startSet("+HSOCKREAD");
+            appendSet("1,200,10000,1");
+            return completeSetPayload(inbound, sizeof(inbound), &length);
+        }
+        case 9:
+            return scanCSQ(SUITES[suite].script);
+        case 10:
+            return fieldsCSQ(fields, SUITES[suite].script);
+        case 11:
+            return scanCCLK(SUITES[suite].script);
+        case 12:
+            return fieldsCCLK(fields, SUITES[suite].script);
+        case 13:
+            return scanHSYS(SUITES[suite].script);
+        case 14:
+            return fieldsHSYS(fields, SUITES[suite].script);
+    }
+    return MODEM_ERROR;
+}
+
+bool ModemBenchmark::run(int suite, benchmark_result &result, uint32_t iterations) {
+    if(suite < 0 || suite >= NUM_SUITES) return false;
+    if(iterations > BENCHMARK_SAMPLES) iterations = BENCHMARK_SAMPLES;
+
+    const char* s = SUITES[suite].script;
+    char hexread[sizeof(script)];
+    if(s == NULL) {
+        //+HSOCKREAD response carrying 200 hex encoded bytes
+        static const char HEX_DIGITS[] = "0123456789ABCDEF";
+        char *p = hexread;
+        p += strlen(strcpy(p, "\r\n+HSOCKREAD: 1,1,200,\""));
+        for(int i=0; i<200; i++) {
+            *p++ = HEX_DIGITS[(i >> 4) & 0x0F];
+            *p++ = HEX_DIGITS[i & 0x0F];
+        }
+        strcpy(p, "\"\r\n\r\nOK\r\n");
+        s = hexread;
+    }
+
+    result.name = SUITES[suite].name;
+    result.calls = iterations;
+    result.errors = 0;
+    result.bytes = 0;
+    result.elapsed_us = 0;
+
+    for(uint32_t i=0; i<iterations; i++) {
+        load(s);
+        consumed = 0;
+        uint32_t start = usTick();
+        modem_result r = step(suite);
+        samples[i] = usTick() - start;
+        if(suite >= 9)
+            consumed = script_length;   //parsers read the line directly
+        result.elapsed_us += samples[i];
+        result.bytes += consumed;
+        if(r != SUITES[suite].expected)
+            result.errors++;
+    }
+    percentiles(samples, iterations, result);
+    return true;
+}
+
+void ModemBenchmark::percentiles(uint32_t *samples, uint32_t count, benchmark_result &result) {
+    for(uint32_t i=1; i<count; i++) {
+        uint32_t v = samples[i];
+        int j = i - 1;
+        while(j >= 0 && samples[j] > v) {
+            samples[j+1] = samples[j];
+            j--;
+        }
+        samples[j+1] = v;
+    }
+    if(count == 0) {
+        result.p50_us = result.p99_us = result.max_us = 0;
+        return;
+    }
+    result.p50_us = samples[count/2];
+    result.p99_us = samples[(count*99)/100 < count ? (count*99)/100 : count-1];
+    result.max_us = samples[count-1];
+}
+
+uint32_t ModemBenchmark::callsPerSecond(const benchmark_result &result) {
+    if(result.elapsed_us == 0) return 0;
+    return (uint32_t)(((uint64_t)result.calls * 1000000) / result.elapsed_us);
+}
+
+uint32_t ModemBenchmark::bytesPerSecond(const benchmark_result &result) {
+    if(result.elapsed_us == 0) return 0;
+    return (uint32_t)(((uint64_t)result.bytes * 1000000) / result.elapsed_us);
+}
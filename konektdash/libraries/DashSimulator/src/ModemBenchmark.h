@@ -0,0 +1,81 @@
+/*
+  ModemBenchmark.h - Measures the AT command engine in Modem by
+  replaying canned system processor responses, so only the parsing and
+  dispatch cost of the Modem layer is timed.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "system/sdk/network/modem/Modem.h"
+#include "system/sdk/network/modem/URCTable.h"
+
+#ifndef BENCHMARK_SAMPLES
+#define BENCHMARK_SAMPLES 200
+#endif
+
+#define BENCHMARK_SCRIPT_SIZE 1024
+
+typedef struct {
+    const char* name;
+    uint32_t calls;
+    uint32_t errors;
+    uint32_t bytes;
+    uint32_t elapsed_us;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+}benchmark_result;
+
+class ModemBenchmark : public Modem, public URCReceiver {
+public:
+    ModemBenchmark(uint32_t (*usTick)(void));
+
+    int numSuites();
+    bool run(int suite, benchmark_result &result, uint32_t iterations=BENCHMARK_SAMPLES);
+
+    static uint32_t callsPerSecond(const benchmark_result &result);
+    static uint32_t bytesPerSecond(const benchmark_result &result);
+    static void percentiles(uint32_t *samples, uint32_t count, benchmark_result &result);
+
+    virtual uint32_t msTick();
+    virtual void onURC(const char* urc);
+
+protected:
+    virtual void modemout(char c) {}
+    virtual void modemout(const char* str);
+    virtual void modemout(uint8_t b) {}
+    virtual void modemout(const uint8_t *data, uint32_t length) {}
+    virtual int modemavailable();
+    virtual uint8_t modemread();
+    virtual uint8_t modempeek();
+
+    void load(const char* script);
+    modem_result step(int suite);
+
+    uint32_t (*usTick)(void);
+    char script[BENCHMARK_SCRIPT_SIZE];
+    uint32_t script_length;
+    uint32_t script_read;
+    uint32_t consumed;
+    uint32_t urcs;
+    ATFields fields;
+    bool armed;
+    uint32_t samples[BENCHMARK_SAMPLES];
+};
@@ -0,0 +1,66 @@
+/*
+  SimulatedModem.cpp - Modem implementation wired directly to a
+  SystemSimulator, with no Arduino dependencies. Lets the Modem layer run on
+  a host against the simulated system processor.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "SimulatedModem.h"
+
+#include <cstring>
+
+SimulatedModem::SimulatedModem(SystemSimulator &system)
+: system(&system) {
+}
+
+void SimulatedModem::begin(URCReceiver &receiver) {
+    init(receiver);
+}
+
+void SimulatedModem::modemout(char c) {
+    system->write((uint8_t)c);
+}
+
+void SimulatedModem::modemout(const char* str) {
+    system->write((const uint8_t*)str, strlen(str));
+}
+
+void SimulatedModem::modemout(uint8_t b) {
+    system->write(b);
+}
+
+void SimulatedModem::modemout(const uint8_t *data, uint32_t length) {
+    system->write(data, length);
+}
+
+int SimulatedModem::modemavailable() {
+    return system->available();
+}
+
+uint8_t SimulatedModem::modemread() {
+    return (uint8_t)system->read();
+}
+
+uint8_t SimulatedModem::modempeek() {
+    return (uint8_t)system->peek();
+}
+
+uint32_t SimulatedModem::msTick() {
+    return system->msTick();
+}
@@ -0,0 +1,45 @@
+/*
+  SimulatedModem.h - Modem implementation wired directly to a
+  SystemSimulator, with no Arduino dependencies. Lets the Modem layer run on
+  a host against the simulated system processor.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "system/sdk/network/modem/Modem.h"
+#include "SystemSimulator.h"
+
+class SimulatedModem : public Modem {
+public:
+    SimulatedModem(SystemSimulator &system);
+    void begin(URCReceiver &receiver);
+    virtual uint32_t msTick();
+
+protected:
+    virtual void modemout(char c);
+    virtual void modemout(const char* str);
+    virtual void modemout(uint8_t b);
+    virtual void modemout(const uint8_t *data, uint32_t length);
+    virtual int modemavailable();
+    virtual uint8_t modemread();
+    virtual uint8_t modempeek();
+
+    SystemSimulator *system;
+};
@@ -0,0 +1,41 @@
+/*
+  SimulatedSystemSerial.h - Stream interface to a SystemSimulator so
+  ArduinoModem and HologramCloud can be pointed at it in place of
+  SerialSystem.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "Stream.h"
+#include "SystemSimulator.h"
+
+class SimulatedSystemSerial : public Stream, public SystemSimulator {
+public:
+    int available() {return SystemSimulator::available();}
+    int read() {return SystemSimulator::read();}
+    int peek() {return SystemSimulator::peek();}
+    void flush() {}
+    size_t write(uint8_t b);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+
+    virtual uint32_t msTick();
+    virtual uint32_t currentTick();
+};
@@ -0,0 +1,485 @@
+/*
+  SystemSimulator.cpp - Software stand-in for the Dash system processor that
+  speaks the +H AT dialect. Has no hardware dependencies so it can drive the
+  Modem and Hologram layers on the Dash or on a host.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "SystemSimulator.h"
+
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+SystemSimulator::SystemSimulator()
+: protocol_version(2), connection_status(1), signal(20), echo(false),
+  default_latency(0), send_latency(0), virtual_ms(0), tick_step(1),
+  write_limit(0), line_rate(0), wire_bits(0), keep_topics(true),
+  network_time(1496318400), network_at(0), network_tz(0) {
+    commands = 0;
+    clearScript();
+    reset(0);
+}
+
+void SystemSimulator::reset(uint32_t boot_ms) {
+    out_head = 0;
+    out_tail = 0;
+    event_seq = 0;
+    for(int i=0; i<SIM_MAX_EVENTS; i++)
+        events[i].type = EVT_NONE;
+    line_length = 0;
+    last_command[0] = 0;
+    raw_remaining = 0;
+    shutdown = false;
+    message_length = 0;
+    last_length = 0;
+    num_topics = 0;
+    for(int i=0; i<SIM_SOCKETS; i++)
+        sockets[i].id = 0;
+    socket_id = 0;
+    listen_port = 0;
+    sms_count = 0;
+    messages = 0;
+    message_bytes = 0;
+    overruns = 0;
+    booting = true;
+    schedule(EVT_BOOT, boot_ms);
+}
+
+void SystemSimulator::setNetworkTime(uint32_t seconds, int tz_quarters) {
+    network_time = seconds;
+    network_at = virtual_ms;
+    network_tz = tz_quarters;
+}
+
+void SystemSimulator::clearScript() {
+    for(int i=0; i<SIM_MAX_RULES; i++) {
+        rules[i].match[0] = 0;
+        rules[i].remaining = 0;
+        rules[i].forever = false;
+    }
+}
+
+bool SystemSimulator::script(const char* match, sim_action action, uint32_t latency, uint32_t count) {
+    if(strlen(match) >= sizeof(rules[0].match)) return false;
+    for(int i=0; i<SIM_MAX_RULES; i++) {
+        if(!rules[i].forever && rules[i].remaining == 0) {
+            strcpy(rules[i].match, match);
+            rules[i].action = action;
+            rules[i].latency = latency;
+            rules[i].remaining = count;
+            rules[i].forever = (count == 0);
+            return true;
+        }
+    }
+    return false;
+}
+
+SystemSimulator::sim_rule* SystemSimulator::findRule(const char* line) {
+    for(int i=0; i<SIM_MAX_RULES; i++) {
+        sim_rule *r = &rules[i];
+        if(!r->forever && r->remaining == 0) continue;
+        if(startsWith(line, r->match)) {
+            if(!r->forever) r->remaining--;
+            return r;
+        }
+    }
+    return NULL;
+}
+
+bool SystemSimulator::startsWith(const char* str, const char* prefix) {
+    return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+bool SystemSimulator::schedule(event_type type, uint32_t delay_ms, const char* text, sim_action action) {
+    for(int i=0; i<SIM_MAX_EVENTS; i++) {
+        sim_event *e = &events[i];
+        if(e->type == EVT_NONE) {
+            if(text) {
+                if(strlen(text) >= SIM_EVENT_SIZE) return false;
+                strcpy(e->text, text);
+            } else {
+                e->text[0] = 0;
+            }
+            e->due = currentTick() + delay_ms;
+            e->seq = event_seq++;
+            e->action = action;
+            e->type = type;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SystemSimulator::update() {
+    uint32_t now = currentTick();
+    while(true) {
+        sim_event *next = NULL;
+        for(int i=0; i<SIM_MAX_EVENTS; i++) {
+            sim_event *e = &events[i];
+            if(e->type == EVT_NONE || (int32_t)(now - e->due) < 0) continue;
+            if(next == NULL || e->seq < next->seq)
+                next = e;
+        }
+        if(next == NULL) return;
+
+        uint8_t type = next->type;
+        next->type = EVT_NONE;
+        switch(type) {
+            case EVT_COMMAND:
+                execute(next->text, (sim_action)next->action);
+                break;
+            case EVT_TEXT:
+                respond(next->text);
+                break;
+            case EVT_SMS:
+            {
+                char header[SIM_EVENT_SIZE];
+                int len = strlen(sms_message);
+                snprintf(header, sizeof(header), "+HHSMSCTX: \"%s\",\"17/06/01,12:00:00\",%d", sms_sender, len);
+                respond(header);
+                output((const uint8_t*)sms_message, len);
+                break;
+            }
+            case EVT_BOOT:
+            {
+                char urc[24];
+                booting = false;
+                snprintf(urc, sizeof(urc), "+HHOLO: %d", protocol_version);
+                respond(urc);
+                break;
+            }
+        }
+    }
+}
+
+void SystemSimulator::write(const uint8_t *buffer, size_t length) {
+    for(size_t i=0; i<length; i++)
+        write(buffer[i]);
+}
+
+void SystemSimulator::wire() {
+    //start + 8 data + stop bits
+    if(line_rate < 1000) return;
+    wire_bits += 10;
+    uint32_t bits_per_ms = line_rate / 1000;
+    while(wire_bits >= bits_per_ms) {
+        wire_bits -= bits_per_ms;
+        virtual_ms++;
+    }
+}
+
+void SystemSimulator::write(uint8_t b) {
+    wire();
+    if(raw_remaining) {
+        if(message_length < SIM_MESSAGE_SIZE)
+            message[message_length++] = b;
+        if(--raw_remaining == 0)
+            schedule(EVT_TEXT, default_latency, "OK");
+        return;
+    }
+    if(shutdown) {
+        //any activity on the line wakes the system processor back up
+        shutdown = false;
+        booting = true;
+        schedule(EVT_BOOT, default_latency);
+        return;
+    }
+    if(booting) return;
+
+    if(b == '\r' || b == '\n') {
+        if(line_length == 0) return;
+        line[line_length] = 0;
+        line_length = 0;
+        commands++;
+        strcpy(last_command, line);
+        if(echo) respond(line);
+
+        sim_rule *r = findRule(line[0] && line[1] ? &line[2] : line);
+        sim_action action = r ? (sim_action)r->action : SIM_RESPOND;
+        if(action == SIM_TIMEOUT) return;
+        schedule(EVT_COMMAND, r ? r->latency : default_latency, line, action);
+    } else if(line_length < SIM_EVENT_SIZE-1) {
+        line[line_length++] = (char)b;
+    }
+}
+
+int SystemSimulator::available() {
+    update();
+    int available = out_head - out_tail;
+    if(available < 0)
+        return SIM_OUTPUT_SIZE + available;
+    return available;
+}
+
+int SystemSimulator::read() {
+    update();
+    if(out_tail == out_head)
+        return -1;
+    uint8_t b = out_buffer[out_tail];
+    out_tail = (out_tail + 1) % SIM_OUTPUT_SIZE;
+    wire();
+    return b;
+}
+
+int SystemSimulator::peek() {
+    update();
+    if(out_tail == out_head)
+        return -1;
+    return out_buffer[out_tail];
+}
+
+void SystemSimulator::output(uint8_t b) {
+    int next = (out_head + 1) % SIM_OUTPUT_SIZE;
+    if(next == out_tail) {
+        overruns++;
+        return;
+    }
+    out_buffer[out_head] = b;
+    out_head = next;
+}
+
+void SystemSimulator::output(const uint8_t *data, size_t length) {
+    for(size_t i=0; i<length; i++)
+        output(data[i]);
+}
+
+void SystemSimulator::output(const char* str) {
+    output((const uint8_t*)str, strlen(str));
+}
+
+void SystemSimulator::outputHex(uint8_t b) {
+    static const char HEX_DIGITS[] = "0123456789ABCDEF";
+    output((uint8_t)HEX_DIGITS[b >> 4]);
+    output((uint8_t)HEX_DIGITS[b & 0x0F]);
+}
+
+void SystemSimulator::respond(const char* line) {
+    output("\r\n");
+    output(line);
+    output("\r\n");
+}
+
+bool SystemSimulator::injectURC(const char* urc, uint32_t delay_ms) {
+    return schedule(EVT_TEXT, delay_ms, urc);
+}
+
+bool SystemSimulator::injectSMS(const char* sender, const char* message, uint32_t delay_ms) {
+    if(strlen(sender) >= sizeof(sms_sender) || strlen(message) >= sizeof(sms_message))
+        return false;
+    strcpy(sms_sender, sender);
+    strcpy(sms_message, message);
+    sms_count = 1;
+    return schedule(EVT_TEXT, delay_ms, "+HHSMSRX: 1");
+}
+
+//a connection that sends data and closes, up to SIM_SOCKETS can be open at once
+bool SystemSimulator::injectInbound(const uint8_t *data, size_t length, uint32_t delay_ms) {
+    sim_socket *s = findSocket(0);
+    if(length > SIM_SOCKET_SIZE || !s) return false;
+    memcpy(s->data, data, length);
+    s->length = length;
+    s->read = 0;
+    s->id = ++socket_id;
+
+    char urc[SIM_EVENT_SIZE];
+    snprintf(urc, sizeof(urc), "+HHSOCKACCEPT: %d,\"10.0.0.1\",%d,0", s->id, listen_port ? listen_port : 4010);
+    return schedule(EVT_TEXT, delay_ms, urc);
+}
+
+SystemSimulator::sim_socket* SystemSimulator::findSocket(int id) {
+    for(int i=0; i<SIM_SOCKETS; i++) {
+        if(sockets[i].id == id) return &sockets[i];
+    }
+    return NULL;
+}
+
+int SystemSimulator::openSockets() {
+    int n = 0;
+    for(int i=0; i<SIM_SOCKETS; i++) {
+        if(sockets[i].id) n++;
+    }
+    return n;
+}
+
+void SystemSimulator::execute(const char* line, sim_action action) {
+    char buffer[SIM_EVENT_SIZE];
+
+    if(action == SIM_ERROR) {
+        respondError();
+        return;
+    } else if(action == SIM_CME_ERROR) {
+        respond("+CME ERROR: 100");
+        return;
+    }
+
+    if(strncmp(line, "AT", 2) != 0 && strncmp(line, "at", 2) != 0) {
+        respondError();
+        return;
+    }
+    const char* cmd = &line[2];
+    const char* value = strchr(cmd, '=');
+    if(value) value++;
+
+    if(cmd[0] == 0) {
+        respondOK();
+    } else if(strcmp(cmd, "+HOLO?") == 0) {
+        snprintf(buffer, sizeof(buffer), "+HOLO: %d", protocol_version);
+        respond(buffer);
+        respondOK();
+    } else if(strcmp(cmd, "+HMRST") == 0) {
+        message_length = 0;
+        num_topics = 0;
+        respondOK();
+    } else if(strcmp(cmd, "+HMRST=1") == 0 && keep_topics) {
+        //payload only, the topics stay for the next message
+        message_length = 0;
+        respondOK();
+    } else if(startsWith(cmd, "+HTOPIC=") || startsWith(cmd, "+HTAG=")) {
+        num_topics++;
+        respondOK();
+    } else if(startsWith(cmd, "+HMWRITE=")) {
+        int n = atoi(value);
+        if(n <= 0 || message_length + n > SIM_MESSAGE_SIZE || (write_limit && n > (int)write_limit)) {
+            respondError();
+        } else {
+            output('@');
+            raw_remaining = n;
+        }
+    } else if(strcmp(cmd, "+HMSEND") == 0) {
+        if(connection_status != 1) {
+            respondError();
+        } else {
+            messages++;
+            message_bytes += message_length;
+            last_length = message_length;
+            schedule(EVT_TEXT, send_latency, "OK");
+        }
+    } else if(strcmp(cmd, "+HCONSTATUS") == 0) {
+        snprintf(buffer, sizeof(buffer), "+HCONSTATUS: %d", connection_status);
+        respond(buffer);
+        respondOK();
+    } else if(strcmp(cmd, "+HCONNECT") == 0) {
+        connection_status = 1;
+        respondOK();
+    } else if(strcmp(cmd, "+HDISCONNECT") == 0) {
+        connection_status = 0;
+        respondOK();
+    } else if(strcmp(cmd, "+HSHUTDOWN") == 0) {
+        respondOK();
+        shutdown = true;
+    } else if(strcmp(cmd, "+CSQ") == 0) {
+        snprintf(buffer, sizeof(buffer), "+CSQ: %d,99", signal);
+        respond(buffer);
+        respondOK();
+    } else if(strcmp(cmd, "+CCLK?") == 0) {
+        if(network_time == 0) {
+            respond("+CCLK: \"04/01/01,00:00:00+00\"");
+        } else {
+            //local time, days to civil date after H. Hinnant
+            int tz = network_tz;
+            uint32_t t = network_time + (virtual_ms - network_at)/1000 + tz*15*60;
+            int32_t z = t/86400 + 719468;
+            uint32_t secs = t%86400;
+            int32_t era = z/146097;
+            uint32_t doe = z - era*146097;
+            uint32_t yoe = (doe - doe/1460 + doe/36524 - doe/146096)/365;
+            uint32_t doy = doe - (365*yoe + yoe/4 - yoe/100);
+            uint32_t mp = (5*doy + 2)/153;
+            uint32_t day = doy - (153*mp + 2)/5 + 1;
+            uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+            uint32_t year = yoe + era*400 + (month <= 2);
+            snprintf(buffer, sizeof(buffer), "+CCLK: \"%02u/%02u/%02u,%02u:%02u:%02u%c%02d\"",
+                year % 100, month, day, secs/3600, secs/60%60, secs%60, tz < 0 ? '-' : '+', abs(tz));
+            respond(buffer);
+        }
+        respondOK();
+    } else if(strcmp(cmd, "+CCID?") == 0) {
+        respond("+CCID: 8944501234567890123");
+        respondOK();
+    } else if(strcmp(cmd, "+CIMI") == 0) {
+        respond("234501234567890");
+        respondOK();
+    } else if(strcmp(cmd, "+HSYS=2") == 0) {
+        respond("+HSYS: 2,\"0.9.9\"");
+        respondOK();
+    } else if(strcmp(cmd, "+UDOPN=12") == 0) {
+        respond("+UDOPN: 12,\"Simulated\"");
+        respondOK();
+    } else if(strcmp(cmd, "+HCHARGE?") == 0) {
+        respond("+HCHARGE: 4");
+        respondOK();
+    } else if(strcmp(cmd, "+HSMS?") == 0) {
+        snprintf(buffer, sizeof(buffer), "+HSMS: %d", sms_count);
+        respond(buffer);
+        respondOK();
+    } else if(strcmp(cmd, "+HSMSRD") == 0) {
+        if(sms_count == 0) {
+            respondError();
+        } else {
+            sms_count--;
+            respondOK();
+            schedule(EVT_SMS, default_latency);
+        }
+    } else if(startsWith(cmd, "+HSOCKLISTEN=")) {
+        listen_port = atoi(value);
+        respond("+HSOCKLISTEN: 1");
+        respondOK();
+    } else if(startsWith(cmd, "+HSOCKREAD=")) {
+        int id = 0, max_len = 0, timeout = 0, hex = 0;
+        sscanf(value, "%d,%d,%d,%d", &id, &max_len, &timeout, &hex);
+        sim_socket *s = id ? findSocket(id) : NULL;
+        int remaining = s ? s->length - s->read : 0;
+        if(remaining <= 0) {
+            //drained, the peer has closed
+            if(s) s->id = 0;
+            respondError();
+        } else {
+            int n = remaining < max_len ? remaining : max_len;
+            snprintf(buffer, sizeof(buffer), "\r\n+HSOCKREAD: %d,%d,%d,\"", id, hex, n);
+            output(buffer);
+            for(int i=0; i<n; i++) {
+                if(hex)
+                    outputHex(s->data[s->read++]);
+                else
+                    output(s->data[s->read++]);
+            }
+            output("\"\r\n");
+            respondOK();
+        }
+    } else if(startsWith(cmd, "+HSOCKCLOSE=")) {
+        sim_socket *s = findSocket(atoi(value));
+        if(s) s->id = 0;
+        respondOK();
+    } else if(startsWith(cmd, "+HLOC=")) {
+        respondOK();
+        schedule(EVT_TEXT, default_latency, "+HHLOC: \"2017/06/01,12:00:00\",45.6334520,13.0618620,49,1");
+    } else if(startsWith(cmd, "+HLED=") || startsWith(cmd, "+HRGBN=") || startsWith(cmd, "+HRGBH=")
+            || startsWith(cmd, "+HPASSTHROUGH=")) {
+        respondOK();
+    } else if(strcmp(cmd, "+HDEBUGTIMEOUT") == 0) {
+        //never respond
+    } else if(startsWith(cmd, "+HDEBUGDELAY=")) {
+        schedule(EVT_TEXT, atoi(value), "OK");
+    } else if(startsWith(cmd, "+HDEBUGDELAYERR=")) {
+        schedule(EVT_TEXT, atoi(value), "ERROR");
+    } else {
+        respondError();
+    }
+}
@@ -0,0 +1,206 @@
+/*
+  SystemSimulator.h - Software stand-in for the Dash system processor that
+  speaks the +H AT dialect. Has no hardware dependencies so it can drive the
+  Modem and Hologram layers on the Dash or on a host.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#ifndef SIM_OUTPUT_SIZE
+#define SIM_OUTPUT_SIZE 2048
+#endif
+
+#ifndef SIM_MAX_EVENTS
+#define SIM_MAX_EVENTS 16
+#endif
+
+#ifndef SIM_MAX_RULES
+#define SIM_MAX_RULES 8
+#endif
+
+#ifndef SIM_MESSAGE_SIZE
+#define SIM_MESSAGE_SIZE 4096
+#endif
+
+#ifndef SIM_SOCKET_SIZE
+#define SIM_SOCKET_SIZE 1024
+#endif
+
+#ifndef SIM_SOCKETS
+#define SIM_SOCKETS 4
+#endif
+
+#define SIM_EVENT_SIZE 96
+
+typedef enum {
+    SIM_RESPOND     = 0,    //normal response after the scripted latency
+    SIM_ERROR       = 1,    //plain ERROR
+    SIM_CME_ERROR   = 2,    //+CME ERROR: 100
+    SIM_TIMEOUT     = 3,    //swallow the command, never respond
+}sim_action;
+
+class SystemSimulator {
+public:
+    SystemSimulator();
+
+    //host (application processor) side of the link
+    void write(uint8_t b);
+    void write(const uint8_t *buffer, size_t length);
+    int available();
+    int read();
+    int peek();
+
+    //scripting
+    void reset(uint32_t boot_ms=0);
+    void setProtocolVersion(int version)            {protocol_version = version;}
+    void setLatency(uint32_t ms)                    {default_latency = ms;}
+    void setSendLatency(uint32_t ms)                {send_latency = ms;}
+    void setEcho(bool on)                           {echo = on;}
+    void setConnectionStatus(int status)            {connection_status = status;}
+    void setSignal(int rssi)                        {signal = rssi;}
+    void setWriteLimit(uint32_t bytes)              {write_limit = bytes;}
+    void setLineRate(uint32_t baud)                 {line_rate = baud;}
+    void setKeepTopics(bool on)                     {keep_topics = on;}
+    //UTC seconds now, advancing with the clock. 0 reports no network time yet
+    void setNetworkTime(uint32_t seconds, int tz_quarters=0);
+    bool script(const char* match, sim_action action, uint32_t latency=0, uint32_t count=0);
+    void clearScript();
+    bool injectURC(const char* urc, uint32_t delay_ms=0);
+    bool injectSMS(const char* sender, const char* message, uint32_t delay_ms=0);
+    bool injectInbound(const uint8_t *data, size_t length, uint32_t delay_ms=0);
+
+    //inspection
+    uint32_t commandCount()                         {return commands;}
+    uint32_t messageCount()                         {return messages;}
+    uint32_t messageBytes()                         {return message_bytes;}
+    uint32_t topicCount()                           {return num_topics;}
+    uint32_t overrunCount()                         {return overruns;}
+    bool isShutdown()                               {return shutdown;}
+    int openSockets();
+    const uint8_t* lastMessage()                    {return message;}
+    uint32_t lastMessageLength()                    {return last_length;}
+    const char* lastCommand()                       {return last_command;}
+
+    //milliseconds since start. The default clock is virtual and advances
+    //one step every time the caller reads it, so scripted latencies elapse
+    //as fast as the caller polls. With a line rate set, every byte across
+    //the link also costs its wire time. Override both to use a real clock.
+    virtual uint32_t msTick()                       {return virtual_ms += tick_step;}
+    virtual uint32_t currentTick()                  {return virtual_ms;}
+    void setTickStep(uint32_t step)                 {tick_step = step;}
+
+protected:
+    typedef enum {
+        EVT_NONE,
+        EVT_COMMAND,
+        EVT_TEXT,
+        EVT_SMS,
+        EVT_BOOT,
+    }event_type;
+
+    typedef struct {
+        uint32_t due;
+        uint32_t seq;
+        uint8_t type;
+        uint8_t action;
+        char text[SIM_EVENT_SIZE];
+    }sim_event;
+
+    typedef struct {
+        int id;                                     //0 when free
+        uint8_t data[SIM_SOCKET_SIZE];
+        uint32_t length;
+        uint32_t read;
+    }sim_socket;
+
+    typedef struct {
+        char match[24];
+        uint8_t action;
+        uint32_t latency;
+        uint32_t remaining;
+        bool forever;
+    }sim_rule;
+
+    void update();
+    bool schedule(event_type type, uint32_t delay_ms, const char* text=NULL, sim_action action=SIM_RESPOND);
+    void execute(const char* line, sim_action action);
+    void respond(const char* line);
+    void respondOK()                                {respond("OK");}
+    void respondError()                             {respond("ERROR");}
+    void output(const char* str);
+    void output(const uint8_t *data, size_t length);
+    void output(uint8_t b);
+    void outputHex(uint8_t b);
+    void wire();
+    sim_rule* findRule(const char* line);
+    sim_socket* findSocket(int id);
+    bool startsWith(const char* str, const char* prefix);
+
+    uint8_t out_buffer[SIM_OUTPUT_SIZE];
+    int out_head;
+    int out_tail;
+
+    sim_event events[SIM_MAX_EVENTS];
+    uint32_t event_seq;
+    sim_rule rules[SIM_MAX_RULES];
+
+    char line[SIM_EVENT_SIZE];
+    int line_length;
+    char last_command[SIM_EVENT_SIZE];
+    uint32_t raw_remaining;
+    bool shutdown;
+    bool booting;
+
+    uint8_t message[SIM_MESSAGE_SIZE];
+    uint32_t message_length;
+    uint32_t last_length;
+    uint32_t num_topics;
+
+    sim_socket sockets[SIM_SOCKETS];
+    int socket_id;
+    int listen_port;
+
+    char sms_sender[21];
+    char sms_message[161];
+    int sms_count;
+
+    int protocol_version;
+    int connection_status;
+    int signal;
+    bool echo;
+    uint32_t default_latency;
+    uint32_t send_latency;
+    uint32_t commands;
+    uint32_t messages;
+    uint32_t message_bytes;
+    uint32_t overruns;
+    uint32_t virtual_ms;
+    uint32_t tick_step;
+    uint32_t write_limit;
+    uint32_t line_rate;
+    uint32_t wire_bits;
+    bool keep_topics;
+    uint32_t network_time;
+    uint32_t network_at;
+    int network_tz;
+};
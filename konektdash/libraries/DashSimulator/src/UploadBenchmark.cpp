@@ -0,0 +1,97 @@
+/*
+  UploadBenchmark.cpp - time chunked +HMWRITE uploads against the simulated
+  system processor, serial or pipelined, on its virtual clock.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include "UploadBenchmark.h"
+#include "Hologram.h"
+
+#include <cstring>
+
+extern Hologram HologramCloud;
+
+UploadBenchmark::UploadBenchmark(uint32_t latency_ms, uint32_t line_rate)
+: modem(system), stream(system) {
+    system.setLatency(latency_ms);
+    system.setLineRate(line_rate);
+    modem.begin(*this);
+    for(uint32_t i=0; i<sizeof(payload); i++)
+        payload[i] = (uint8_t)(i * 7);
+}
+
+bool UploadBenchmark::run(uint32_t length, uint32_t chunk, bool pipeline, benchmark_result &result, uint32_t iterations) {
+    if(length > sizeof(payload) || chunk == 0) return false;
+    if(iterations > UPLOAD_BENCHMARK_SAMPLES) iterations = UPLOAD_BENCHMARK_SAMPLES;
+
+    result.name = pipeline ? "+HMWRITE pipelined" : "+HMWRITE serial";
+    result.calls = iterations;
+    result.errors = 0;
+    result.bytes = 0;
+    result.elapsed_us = 0;
+
+    for(uint32_t i=0; i<iterations; i++) {
+        if(modem.command("+HMRST") != MODEM_OK) {
+            result.errors++;
+            samples[i] = 0;
+            continue;
+        }
+        uint32_t written = 0;
+        uint32_t start = system.currentTick();
+        modem_result r = modem.writeChunked("+HMWRITE", payload, length, chunk, &written, pipeline);
+        samples[i] = (system.currentTick() - start) * 1000;
+        result.elapsed_us += samples[i];
+        result.bytes += written;
+        if(r != MODEM_OK || written != length || memcmp(system.lastMessage(), payload, length) != 0)
+            result.errors++;
+    }
+    ModemBenchmark::percentiles(samples, iterations, result);
+    return true;
+}
+
+bool UploadBenchmark::runMessage(uint32_t length, benchmark_result &result, uint32_t iterations) {
+    if(length > sizeof(payload) || length > MAX_MESSAGE_SIZE) return false;
+    if(iterations > UPLOAD_BENCHMARK_SAMPLES) iterations = UPLOAD_BENCHMARK_SAMPLES;
+
+    result.name = "sendMessage";
+    result.calls = iterations;
+    result.errors = 0;
+    result.bytes = 0;
+    result.elapsed_us = 0;
+
+    HologramCloud.begin(stream);
+    HologramCloud.clear(); //begin keeps what was buffered
+    if(!HologramCloud.powerUp()) return false;
+
+    for(uint32_t i=0; i<iterations; i++) {
+        uint32_t sent = system.messageCount();
+        uint32_t start = system.currentTick();
+        bool ok = HologramCloud.sendMessage(payload, length);
+        samples[i] = (system.currentTick() - start) * 1000;
+        result.elapsed_us += samples[i];
+        //a compressor set on HologramCloud shows up as errors here
+        if(ok && system.messageCount() == sent + 1 && system.lastMessageLength() == length &&
+           memcmp(system.lastMessage(), payload, length) == 0)
+            result.bytes += length;
+        else
+            result.errors++;
+    }
+    ModemBenchmark::percentiles(samples, iterations, result);
+    return true;
+}
@@ -0,0 +1,75 @@
+/*
+  UploadBenchmark.h - time chunked +HMWRITE uploads against the simulated
+  system processor, serial or pipelined, on its virtual clock. Whole
+  sendMessage calls can be timed the same way.
+
+  https://hologram.io
+
+  Copyright (c) 2017 Konekt, Inc.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "Stream.h"
+#include "SystemSimulator.h"
+#include "SimulatedModem.h"
+#include "ModemBenchmark.h"
+
+#ifndef UPLOAD_BENCHMARK_SIZE
+#define UPLOAD_BENCHMARK_SIZE 4096
+#endif
+
+#ifndef UPLOAD_BENCHMARK_SAMPLES
+#define UPLOAD_BENCHMARK_SAMPLES 16
+#endif
+
+//a Stream onto the benchmark's simulator for HologramCloud. Its modem
+//times out on millis(), so each poll steps the virtual clock instead
+class UploadStream : public Stream {
+public:
+    UploadStream(SystemSimulator &system) : system(system) {}
+    int available() {system.msTick(); return system.available();}
+    int read() {return system.read();}
+    int peek() {return system.peek();}
+    void flush() {}
+    size_t write(uint8_t b) {system.write(b); return 1;}
+    size_t write(const uint8_t *buffer, size_t size) {system.write(buffer, size); return size;}
+    using Print::write;
+
+protected:
+    SystemSimulator &system;
+};
+
+class UploadBenchmark : public URCReceiver {
+public:
+    UploadBenchmark(uint32_t latency_ms=5, uint32_t line_rate=115200);
+
+    //elapsed and percentiles are simulated link time, not CPU time
+    bool run(uint32_t length, uint32_t chunk, bool pipeline, benchmark_result &result, uint32_t iterations=UPLOAD_BENCHMARK_SAMPLES);
+    //the whole HologramCloud.sendMessage, +HMRST to +HMSEND. HologramCloud
+    //is begun on the simulator, begin it again on SerialSystem after
+    bool runMessage(uint32_t length, benchmark_result &result, uint32_t iterations=UPLOAD_BENCHMARK_SAMPLES);
+    SystemSimulator& simulator() {return system;}
+
+    virtual void onURC(const char* urc) {}
+
+protected:
+    SystemSimulator system;
+    SimulatedModem modem;
+    UploadStream stream;
+    uint8_t payload[UPLOAD_BENCHMARK_SIZE];
+    uint32_t samples[UPLOAD_BENCHMARK_SAMPLES];
+};